@@ -1,14 +1,19 @@
 #version 330
 
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
 in vec3 fcolor;
 out vec4 color_out;
-uniform vec3 lightPos;
 in vec3 uPos;
 in vec3 uNorm;
 float ambient = .1;
 
 void main(){
-        vec3 L = normalize(lightPos - uPos);
+        vec3 L = normalize(lightPosition.xyz - uPos);
         color_out = vec4(fcolor, 1) * (dot(uNorm, L) + ambient) ;
 
 }
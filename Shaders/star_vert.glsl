@@ -1,7 +1,11 @@
 #version 330
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
 uniform mat4 model;
 
 
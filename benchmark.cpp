@@ -0,0 +1,333 @@
+#include "benchmark.h"
+#include "matrixbatch.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFramebufferObjectFormat>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Control points of the camera path, a closed loop that starts south of
+// the flock, weaves through it, skims the lake and circles back past the
+// hill and the trees.
+static const vec3 pathPoints[] = {
+    vec3(0, .5, 22),
+    vec3(2, .5, 8),
+    vec3(3, .3, 2),
+    vec3(7, .8, -4),
+    vec3(10, .2, -10),
+    vec3(16, 2, -16),
+    vec3(0, 3, -14),
+    vec3(-15, 2, -6),
+    vec3(-12, 1, 10),
+    vec3(12, 1.5, 14)
+};
+static const int pathPointCount = sizeof(pathPoints) / sizeof(pathPoints[0]);
+
+Benchmark::Benchmark(const Options &opts) : options(opts) {
+    droppedFrames = 0;
+}
+
+vec3 Benchmark::cameraPath(float t) {
+    // Uniform Catmull-Rom spline through the control points, t in [0, 1).
+    float f = t * pathPointCount;
+    int i = (int)f;
+    float u = f - i;
+
+    vec3 p0 = pathPoints[(i + pathPointCount - 1) % pathPointCount];
+    vec3 p1 = pathPoints[i % pathPointCount];
+    vec3 p2 = pathPoints[(i + 1) % pathPointCount];
+    vec3 p3 = pathPoints[(i + 2) % pathPointCount];
+
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return ((p1 * 2.0f) +
+            (p2 - p0) * u +
+            (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * u2 +
+            (p1 * 3.0f - p0 - p2 * 3.0f + p3) * u3) * .5f;
+}
+
+void Benchmark::denseFieldCamera(float t, vec3 &eye, vec3 &target) {
+    // One slow circle a few sheep up, looking down and across the flock
+    // so it runs from the bottom of the screen to the horizon.
+    float angle = t * 2 * 3.14159265f;
+    eye = vec3(sinf(angle) * 4, 1.5f, cosf(angle) * 4);
+    target = vec3(sinf(angle) * -4, 0, cosf(angle) * -4);
+}
+
+int Benchmark::run() {
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSwapInterval(0);
+
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    if(!context.create() || !context.makeCurrent(&surface)) {
+        std::cerr << "Could not create an offscreen GL 3.3 core context" << std::endl;
+        return 1;
+    }
+    initializeOpenGLFunctions();
+    rendererName = (const char *)glGetString(GL_RENDERER);
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::Depth);
+    QOpenGLFramebufferObject fbo(options.width, options.height, fboFormat);
+    fbo.bind();
+    glViewport(0, 0, options.width, options.height);
+
+    Renderer renderer;
+    renderer.setScenePath(options.scenePath);
+    renderer.initialize();
+    renderer.resize(options.width, options.height);
+    renderer.setStressMode(options.stress || options.denseField);
+    renderer.setInverseNormals(options.inverseNormals);
+
+    // GPU times come from the renderer's own per-pass profiler scopes,
+    // which are read back a few frames late and summed per frame.
+    Profiler &profiler = renderer.profiler();
+    profiler.setRecordFrames(true);
+
+    frames.resize(options.frames);
+    QElapsedTimer cpuTimer;
+
+    for(int i = 0; i < options.frames; i++) {
+        float t = (float)i / options.frames;
+        vec3 eye, ahead;
+        if(options.denseField) {
+            denseFieldCamera(t, eye, ahead);
+        } else {
+            eye = cameraPath(t);
+            ahead = cameraPath(fmodf(t + .01f, 1.0f));
+        }
+        renderer.setCamera(glm::lookAt(eye, ahead, vec3(0,1,0)), eye);
+
+        cpuTimer.start();
+        // One fixed step a frame, so every run sees the same flock.
+        renderer.simulate(1 / 120.0f);
+        renderer.render();
+        // Make sure the driver has actually been handed the frame before
+        // the CPU side is considered done.
+        glFlush();
+
+        const RenderQueue::Stats &stats = renderer.queueStats();
+        Frame &frame = frames[i];
+        frame.cpuMs = cpuTimer.nsecsElapsed() / 1000000.0;
+        frame.draws = stats.draws;
+        frame.stateChanges = stats.programChanges + stats.vaoChanges +
+                             stats.textureChanges + stats.materialChanges;
+        frame.savedChanges = stats.savedChanges;
+        const Renderer::CullStats &cull = renderer.cullingStats();
+        frame.visible = cull.visibleObjects + cull.visibleSheep;
+        frame.culled = cull.culledObjects + cull.culledSheep;
+    }
+
+    profiler.flush();
+    for(int i = 0; i < options.frames; i++) {
+        frames[i].gpuMs = profiler.recordedGpuMs(i);
+    }
+    droppedFrames = profiler.droppedFrames();
+
+    if(!options.tracePath.isEmpty()) {
+        profiler.writeChromeTrace(options.tracePath);
+    }
+
+    fbo.release();
+    context.doneCurrent();
+
+    bool ok = true;
+    if(!options.csvPath.isEmpty()) {
+        ok = writeCsv() && ok;
+    }
+    if(!options.jsonPath.isEmpty()) {
+        ok = writeJson() && ok;
+    }
+    return ok ? 0 : 1;
+}
+
+bool Benchmark::writeCsv() const {
+    std::ofstream out(options.csvPath.toStdString().c_str());
+    if(!out) {
+        std::cerr << "Could not write " << options.csvPath.toStdString() << std::endl;
+        return false;
+    }
+
+    out << "frame,cpu_ms,gpu_ms,draws,state_changes,saved_changes,visible,culled\n";
+    for(size_t i = 0; i < frames.size(); i++) {
+        const Frame &f = frames[i];
+        out << i << "," << f.cpuMs << "," << f.gpuMs << "," << f.draws << ","
+            << f.stateChanges << "," << f.savedChanges << ","
+            << f.visible << "," << f.culled << "\n";
+    }
+    return true;
+}
+
+// Writes "name": {"mean": .., "p50": .., "p95": .., "max": ..} for one
+// timing column, leaving out the warmup frames.
+static void writeSummary(std::ostream &out, const char *name, std::vector<double> values) {
+    double mean = 0, p50 = 0, p95 = 0, max = 0;
+    if(!values.empty()) {
+        std::sort(values.begin(), values.end());
+        for(size_t i = 0; i < values.size(); i++) {
+            mean += values[i];
+        }
+        mean /= values.size();
+        p50 = values[values.size() / 2];
+        p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+        max = values.back();
+    }
+    out << "  \"" << name << "\": {\"mean\": " << mean << ", \"p50\": " << p50
+        << ", \"p95\": " << p95 << ", \"max\": " << max << "},\n";
+}
+
+bool Benchmark::writeJson() const {
+    std::ofstream out(options.jsonPath.toStdString().c_str());
+    if(!out) {
+        std::cerr << "Could not write " << options.jsonPath.toStdString() << std::endl;
+        return false;
+    }
+
+    std::vector<double> cpu, gpu;
+    for(size_t i = options.warmup; i < frames.size(); i++) {
+        cpu.push_back(frames[i].cpuMs);
+        // Frames whose queries weren't ready in time have no GPU time.
+        if(frames[i].gpuMs >= 0) {
+            gpu.push_back(frames[i].gpuMs);
+        }
+    }
+
+    // The renderer string comes from the driver; keep it from breaking
+    // the JSON.
+    std::string name = rendererName.toStdString();
+    std::replace(name.begin(), name.end(), '"', '\'');
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    out << "{\n";
+    out << "  \"renderer\": \"" << name << "\",\n";
+    out << "  \"width\": " << options.width << ",\n";
+    out << "  \"height\": " << options.height << ",\n";
+    out << "  \"stress\": " << (options.stress ? "true" : "false") << ",\n";
+    out << "  \"dense_field\": " << (options.denseField ? "true" : "false") << ",\n";
+    out << "  \"normals\": \"" << (options.inverseNormals ? "inverse" : "precomputed") << "\",\n";
+    out << "  \"warmup\": " << options.warmup << ",\n";
+    out << "  \"gpu_dropped\": " << droppedFrames << ",\n";
+    writeSummary(out, "cpu_ms", cpu);
+    writeSummary(out, "gpu_ms", gpu);
+    out << "  \"frames\": [\n";
+    for(size_t i = 0; i < frames.size(); i++) {
+        const Frame &f = frames[i];
+        out << "    {\"cpu_ms\": " << f.cpuMs << ", \"gpu_ms\": " << f.gpuMs
+            << ", \"draws\": " << f.draws << ", \"state_changes\": " << f.stateChanges
+            << ", \"saved_changes\": " << f.savedChanges
+            << ", \"visible\": " << f.visible << ", \"culled\": " << f.culled << "}"
+            << (i + 1 < frames.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return true;
+}
+
+int Benchmark::runTransforms(int sheep, int rounds) {
+    // A synthetic hierarchy, not what the renderer composes (a sheep there
+    // is one node, posed in the shader): each root followed by a handful of
+    // children, so the kernel reads parents as well as writing worlds. The
+    // locals are already in the kernel's streams.
+    const int parts = 13;
+    int nodes = sheep * (parts + 1);
+    std::vector<int> parents(nodes);
+    std::vector<mat4> locals(nodes);
+    std::vector<float> elements[16];
+    for(int e = 0; e < 16; e++) {
+        elements[e].resize(nodes);
+    }
+
+    for(int n = 0; n < nodes; n++) {
+        int part = n % (parts + 1);
+        parents[n] = part == 0 ? -1 : n - part;
+        float f = (float)n;
+        mat4 local = glm::translate(mat4(1.0f), vec3(fmodf(f * .37f, 50.0f), part * .1f, fmodf(f * .73f, 50.0f)));
+        local = glm::rotate(local, f * .01f, vec3(0,1,0));
+        locals[n] = glm::scale(local, vec3(.1f + part * .01f));
+
+        const float *m = glm::value_ptr(locals[n]);
+        for(int e = 0; e < 16; e++) {
+            elements[e][n] = m[e];
+        }
+    }
+
+    MatrixStreams streams;
+    for(int e = 0; e < 16; e++) {
+        streams.elements[e] = &elements[e][0];
+    }
+
+    QElapsedTimer timer;
+    std::vector<mat4> reference(nodes);
+    qint64 best = -1;
+    for(int r = 0; r < rounds; r++) {
+        timer.start();
+        for(int n = 0; n < nodes; n++) {
+            int p = parents[n];
+            reference[n] = p >= 0 ? reference[p] * locals[n] : locals[n];
+        }
+        qint64 ns = timer.nsecsElapsed();
+        best = best < 0 ? ns : std::min(best, ns);
+    }
+    double glmNs = (double)best / nodes;
+    std::cout << nodes << " nodes, best of " << rounds << " rounds" << std::endl;
+    std::cout << "glm: " << glmNs << " ns/matrix" << std::endl;
+
+    // Written into a separate buffer, the way it would go into a mapped
+    // instance buffer.
+    std::vector<mat4> out(nodes);
+    bool ok = true;
+    for(int level = composeScalar; level < composeLevelCount; level++) {
+        const char *name = composeLevelName((ComposeLevel)level);
+        ComposeKernel compose = composeKernel((ComposeLevel)level);
+        if(!compose) {
+            std::cout << name << ": not supported here" << std::endl;
+            continue;
+        }
+
+        best = -1;
+        for(int r = 0; r < rounds; r++) {
+            timer.start();
+            compose(&out[0], &parents[0], streams, 0, nodes, &out[0]);
+            qint64 ns = timer.nsecsElapsed();
+            best = best < 0 ? ns : std::min(best, ns);
+        }
+
+        float error = 0;
+        for(int n = 0; n < nodes; n++) {
+            const float *a = glm::value_ptr(out[n]);
+            const float *b = glm::value_ptr(reference[n]);
+            for(int e = 0; e < 16; e++) {
+                error = std::max(error, fabsf(a[e] - b[e]));
+            }
+        }
+        // The scene is 50 units across, fma and a different summation
+        // order should stay well inside this.
+        if(error > 1e-3f) {
+            ok = false;
+        }
+
+        double kernelNs = (double)best / nodes;
+        std::cout << name << ": " << kernelNs << " ns/matrix, " << glmNs / kernelNs
+                  << "x glm, max error " << error
+                  << (level == composeLevel() ? " (in use)" : "") << std::endl;
+    }
+
+    if(!ok) {
+        std::cerr << "A compose kernel disagrees with glm" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
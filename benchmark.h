@@ -0,0 +1,73 @@
+#ifndef __BENCHMARK__INCLUDE__
+#define __BENCHMARK__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <glm/glm.hpp>
+#include <vector>
+
+using glm::vec3;
+
+// Headless benchmark: draws the scene into an offscreen framebuffer as
+// fast as it will go while flying a fixed camera path through the sheep
+// field and over the lake, then writes per-frame timings out as CSV and
+// JSON. Needs no window, no vsync and no user input, so it also runs on
+// build machines with only a software rasterizer such as llvmpipe.
+class Benchmark : protected QOpenGLFunctions_3_3_Core {
+    public:
+        struct Options {
+            int frames;
+            // Frames left out of the summary while caches warm up.
+            int warmup;
+            int width;
+            int height;
+            bool stress;
+            // Circle low over the middle of the stress flock instead, with
+            // sheep filling the screen, so the frame is vertex bound.
+            bool denseField;
+            // Invert model matrices per vertex for normals, as the shaders
+            // used to, to compare against.
+            bool inverseNormals;
+            QString scenePath;
+            QString csvPath;
+            QString jsonPath;
+            // Chrome trace of the run's profiler scopes, if set.
+            QString tracePath;
+        };
+
+        Benchmark(const Options &options);
+
+        // Returns a process exit code.
+        int run();
+
+        // CPU only: times composing the world matrices of a synthetic
+        // hierarchy, a root per sheep with a few children each, with plain
+        // glm, as the hierarchy used to, against each compose kernel this
+        // machine can run. Returns an exit code.
+        static int runTransforms(int sheep, int rounds);
+
+    private:
+        struct Frame {
+            double cpuMs;
+            // -1 if the frame's timer queries weren't ready in time.
+            double gpuMs;
+            int draws;
+            int stateChanges;
+            int savedChanges;
+            // Static objects and sheep, together.
+            int visible;
+            int culled;
+        };
+
+        static vec3 cameraPath(float t);
+        static void denseFieldCamera(float t, vec3 &eye, vec3 &target);
+        bool writeCsv() const;
+        bool writeJson() const;
+
+        Options options;
+        std::vector<Frame> frames;
+        QString rendererName;
+        int droppedFrames;
+};
+
+#endif
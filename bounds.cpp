@@ -0,0 +1,156 @@
+#include "bounds.h"
+
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define BOUNDS_SSE
+#endif
+
+Aabb::Aabb() : min(FLT_MAX), max(-FLT_MAX) {
+}
+
+Aabb::Aabb(vec3 lo, vec3 hi) : min(lo), max(hi) {
+}
+
+void Aabb::grow(const Aabb &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+Aabb Aabb::transformed(const mat4 &transform) const {
+    // Arvo's method: the new extent along each axis is the old extent
+    // projected onto it through the absolute value of the rotation.
+    vec3 c = vec3(transform * vec4(center(), 1));
+    vec3 e = extent();
+    vec3 r;
+    for(int i = 0; i < 3; i++) {
+        r[i] = fabsf(transform[0][i]) * e.x +
+               fabsf(transform[1][i]) * e.y +
+               fabsf(transform[2][i]) * e.z;
+    }
+    return Aabb(c - r, c + r);
+}
+
+Frustum::Frustum() {
+    for(int i = 0; i < 8; i++) {
+        nx[i] = 0;
+        ny[i] = 0;
+        nz[i] = 0;
+        d[i] = 1;
+    }
+}
+
+Frustum::Frustum(const mat4 &m) {
+    // Gribb and Hartmann: each plane is the last row of the matrix plus
+    // or minus one of the others. glm is column major, so row i is
+    // (m[0][i], m[1][i], m[2][i], m[3][i]).
+    for(int i = 0; i < 3; i++) {
+        for(int side = 0; side < 2; side++) {
+            float sign = side == 0 ? 1.0f : -1.0f;
+            vec4 plane(m[0][3] + sign * m[0][i],
+                       m[1][3] + sign * m[1][i],
+                       m[2][3] + sign * m[2][i],
+                       m[3][3] + sign * m[3][i]);
+            // Normalized so that sphere radii can be compared directly.
+            plane /= glm::length(vec3(plane));
+
+            int p = i * 2 + side;
+            nx[p] = plane.x;
+            ny[p] = plane.y;
+            nz[p] = plane.z;
+            d[p] = plane.w;
+        }
+    }
+    for(int p = 6; p < 8; p++) {
+        nx[p] = 0;
+        ny[p] = 0;
+        nz[p] = 0;
+        d[p] = 1;
+    }
+}
+
+Frustum::Result Frustum::classify(const Aabb &box) const {
+    vec3 c = box.center();
+    vec3 e = box.extent();
+
+#ifdef BOUNDS_SSE
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    __m128 zero = _mm_setzero_ps();
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    int out = 0;
+    int straddle = 0;
+    for(int i = 0; i < 8; i += 4) {
+        __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+        // Distance from the plane to the centre, and the box's radius
+        // along the plane normal.
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+                                 _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(d + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, absMask), ex),
+                                              _mm_mul_ps(_mm_and_ps(py, absMask), ey)),
+                                   _mm_mul_ps(_mm_and_ps(pz, absMask), ez));
+        out |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+        straddle |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), zero));
+    }
+    if(out) {
+        return outside;
+    }
+    return straddle ? intersecting : inside;
+#else
+    Result result = inside;
+    for(int i = 0; i < 6; i++) {
+        float dist = nx[i] * c.x + ny[i] * c.y + nz[i] * c.z + d[i];
+        float radius = fabsf(nx[i]) * e.x + fabsf(ny[i]) * e.y + fabsf(nz[i]) * e.z;
+        if(dist + radius < 0) {
+            return outside;
+        }
+        if(dist - radius < 0) {
+            result = intersecting;
+        }
+    }
+    return result;
+#endif
+}
+
+void Frustum::testSpheres(const float *x, const float *y, const float *z, const float *r,
+                          int count, uint8_t *visible) const {
+    int i = 0;
+
+#ifdef BOUNDS_SSE
+    for(; i + 4 <= count; i += 4) {
+        __m128 sx = _mm_loadu_ps(x + i), sy = _mm_loadu_ps(y + i), sz = _mm_loadu_ps(z + i);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+
+        // Four spheres against one plane at a time; a sphere is out as
+        // soon as it is entirely behind any plane.
+        __m128 out = _mm_setzero_ps();
+        for(int p = 0; p < 6; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nx[p]), sx),
+                                                _mm_mul_ps(_mm_set1_ps(ny[p]), sy)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(nz[p]), sz),
+                                                _mm_set1_ps(d[p])));
+            out = _mm_or_ps(out, _mm_cmplt_ps(dist, negR));
+        }
+
+        int mask = _mm_movemask_ps(out);
+        visible[i] = !(mask & 1);
+        visible[i + 1] = !(mask & 2);
+        visible[i + 2] = !(mask & 4);
+        visible[i + 3] = !(mask & 8);
+    }
+#endif
+
+    for(; i < count; i++) {
+        uint8_t in = 1;
+        for(int p = 0; p < 6; p++) {
+            if(nx[p] * x[i] + ny[p] * y[i] + nz[p] * z[i] + d[p] < -r[i]) {
+                in = 0;
+                break;
+            }
+        }
+        visible[i] = in;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef __BOUNDS__INCLUDE__
+#define __BOUNDS__INCLUDE__
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+struct Aabb {
+    vec3 min;
+    vec3 max;
+
+    Aabb();
+    Aabb(vec3 min, vec3 max);
+
+    vec3 center() const { return (min + max) * .5f; }
+    vec3 extent() const { return (max - min) * .5f; }
+
+    void grow(const Aabb &other);
+    // Bounds of this box after transform, which may rotate it.
+    Aabb transformed(const mat4 &transform) const;
+};
+
+// The six planes of a view frustum, pointing inwards, kept as structure
+// of arrays so four planes can be tested against a box at a time with
+// SSE. There are two spare planes that everything is inside of.
+class Frustum {
+    public:
+        enum Result {
+            outside,
+            intersecting,
+            inside
+        };
+
+        Frustum();
+        // From projection * view.
+        Frustum(const mat4 &viewProjection);
+
+        Result classify(const Aabb &box) const;
+
+        // Tests count spheres at once, four at a time. visible[i] is set to
+        // 1 if sphere i is at least partly in the frustum, 0 if not.
+        void testSpheres(const float *x, const float *y, const float *z, const float *r,
+                         int count, uint8_t *visible) const;
+
+    private:
+        alignas(16) float nx[8];
+        alignas(16) float ny[8];
+        alignas(16) float nz[8];
+        alignas(16) float d[8];
+};
+
+#endif
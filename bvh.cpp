@@ -0,0 +1,110 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+namespace {
+
+// Orders item indices by their box's centre along one axis.
+struct CenterLess {
+    const std::vector<Aabb> *boxes;
+    int axis;
+
+    bool operator()(int a, int b) const {
+        return (*boxes)[a].center()[axis] < (*boxes)[b].center()[axis];
+    }
+};
+
+}
+
+void Bvh::build(const std::vector<Aabb> &boxes) {
+    itemBounds = boxes;
+    nodes.clear();
+    items.resize(boxes.size());
+    for(size_t i = 0; i < boxes.size(); i++) {
+        items[i] = (int)i;
+    }
+    if(!boxes.empty()) {
+        nodes.reserve(boxes.size() * 2);
+        buildNode(boxes, 0, (int)boxes.size());
+    }
+}
+
+int Bvh::buildNode(const std::vector<Aabb> &boxes, int first, int count) {
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    Aabb bounds;
+    for(int i = first; i < first + count; i++) {
+        bounds.grow(boxes[items[i]]);
+    }
+    nodes[index].bounds = bounds;
+    nodes[index].first = first;
+    nodes[index].count = count;
+    nodes[index].right = 0;
+
+    if(count <= leafSize) {
+        return index;
+    }
+
+    vec3 size = bounds.max - bounds.min;
+    CenterLess less;
+    less.boxes = &boxes;
+    less.axis = 0;
+    if(size.y > size[less.axis]) {
+        less.axis = 1;
+    }
+    if(size.z > size[less.axis]) {
+        less.axis = 2;
+    }
+
+    int half = count / 2;
+    std::nth_element(items.begin() + first, items.begin() + first + half,
+                     items.begin() + first + count, less);
+
+    buildNode(boxes, first, half);
+    // nodes may have grown, so no references into it across the calls.
+    int right = buildNode(boxes, first + half, count - half);
+    nodes[index].right = right;
+    return index;
+}
+
+int Bvh::query(const Frustum &frustum, std::vector<int> &visible) const {
+    if(nodes.empty()) {
+        return 0;
+    }
+
+    int tested = 0;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while(top > 0) {
+        const Node &node = nodes[stack[--top]];
+        tested++;
+
+        Frustum::Result result = frustum.classify(node.bounds);
+        if(result == Frustum::outside) {
+            continue;
+        }
+        if(result == Frustum::inside) {
+            for(int i = node.first; i < node.first + node.count; i++) {
+                visible.push_back(items[i]);
+            }
+            continue;
+        }
+        if(node.right == 0) {
+            for(int i = node.first; i < node.first + node.count; i++) {
+                tested++;
+                if(frustum.classify(itemBounds[items[i]]) != Frustum::outside) {
+                    visible.push_back(items[i]);
+                }
+            }
+            continue;
+        }
+
+        int self = (int)(&node - &nodes[0]);
+        stack[top++] = node.right;
+        stack[top++] = self + 1;
+    }
+    return tested;
+}
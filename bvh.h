@@ -0,0 +1,42 @@
+#ifndef __BVH__INCLUDE__
+#define __BVH__INCLUDE__
+
+#include <vector>
+
+#include "bounds.h"
+
+// Bounding volume hierarchy over boxes that don't move. Built once,
+// top down, splitting at the median along each node's longest axis.
+// Every node covers a contiguous run of items, so a node that is
+// entirely inside the frustum hands over its whole run without testing
+// anything below it.
+class Bvh {
+    public:
+        void build(const std::vector<Aabb> &boxes);
+
+        // Appends the index of every box at least partly in the frustum.
+        // Returns how many boxes were tested.
+        int query(const Frustum &frustum, std::vector<int> &visible) const;
+
+        int size() const { return (int)items.size(); }
+
+    private:
+        static const int leafSize = 2;
+
+        struct Node {
+            Aabb bounds;
+            // Run of items under this node.
+            int first;
+            int count;
+            // Left child is always the next node; 0 for leaves.
+            int right;
+        };
+
+        int buildNode(const std::vector<Aabb> &boxes, int first, int count);
+
+        std::vector<Node> nodes;
+        std::vector<int> items;
+        std::vector<Aabb> itemBounds;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "cameracontroller.h"
+
+#include <Qt>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+using glm::inverse;
+using glm::length;
+using glm::normalize;
+
+CameraController::CameraController() {
+    pitch = 0;
+    yaw = 0;
+    pitchMatrix = mat4(1.0f);
+    yawMatrix = mat4(1.0f);
+    orientation = mat4(1.0f);
+
+    forward = false;
+    back = false;
+    left = false;
+    right = false;
+    up = false;
+    down = false;
+    fly = false;
+    ground = 0;
+
+    velocity = vec3(0,0,0);
+    position = vec3(0,0,0);
+    previousPosition = position;
+}
+
+bool CameraController::keyPressed(int key) {
+    switch(key) {
+        case Qt::Key_W:
+            // forward
+            forward = true;
+            break;
+        case Qt::Key_A:
+            // left
+            left = true;
+            break;
+        case Qt::Key_D:
+            // right
+            right = true;
+            break;
+        case Qt::Key_S:
+            // backward
+            back = true;
+            break;
+        case Qt::Key_Tab:
+            // toggle fly mode
+            if(fly)
+                fly = false;
+            else if(!fly)
+                fly = true;
+            break;
+        case Qt::Key_Shift:
+            // down
+            down = true;
+            break;
+        case Qt::Key_Space:
+            // up or jump
+            up = true;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool CameraController::keyReleased(int key) {
+    switch(key) {
+        case Qt::Key_W:
+            // forward
+            forward = false;
+            break;
+        case Qt::Key_A:
+            // left
+            left = false;
+            break;
+        case Qt::Key_D:
+            // right
+            right = false;
+            break;
+        case Qt::Key_S:
+            // backward
+            back = false;
+            break;
+        case Qt::Key_Tab:
+            // toggle fly mode
+            break;
+        case Qt::Key_Shift:
+            // down
+            down = false;
+            break;
+        case Qt::Key_Space:
+            // up or jump
+            up = true;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+void CameraController::mousePressed(vec2 pt) {
+    lastPt = pt;
+}
+
+void CameraController::mouseMoved(vec2 pt) {
+    vec2 d = pt-lastPt;
+
+    yaw += d.x/100;
+    pitch += d.y/100;
+
+    if(pitch > M_PI/2) {
+        pitch = M_PI/2;
+    } else if (pitch < -M_PI/2) {
+        pitch = -M_PI/2;
+    }
+
+    yawMatrix = glm::rotate(mat4(1.0f), yaw, vec3(0,1,0));
+    pitchMatrix = glm::rotate(mat4(1.0f), pitch, vec3(1,0,0));
+
+    orientation = yawMatrix*pitchMatrix;
+
+    lastPt = pt;
+}
+
+void CameraController::step(float dt) {
+    previousPosition = position;
+
+    vec3 forwardVec = -vec3(yawMatrix[2]);
+    vec3 upVec = vec3(0,1,0);
+
+    velocity = vec3(0,0,0);
+
+    if(!fly) {
+        forwardVec = -vec3(yawMatrix[2]);
+        velocity += -upVec;
+    }
+    if(fly)
+        forwardVec = -vec3(orientation[2]);
+
+    vec3 rightVec = vec3(orientation[0]);
+
+    float speed = 3;
+
+    if(forward) {
+        velocity += forwardVec;
+    }
+    if(right) {
+        velocity += rightVec;
+    }
+    if(left) {
+        velocity += -rightVec;
+    }
+    if(back) {
+        velocity += -forwardVec;
+    }
+
+    if(length(velocity) > 0) {
+        velocity = normalize(velocity);
+    }
+
+    position += velocity*speed*dt;
+
+    // Eyes half a unit off the ground. Walking keeps them there, up hills
+    // and down; flying only stops them going under.
+    float floorY = ground ? ground->height(position.x, position.z) + .5f : 0;
+    if(!fly || position.y < floorY)
+        position.y = floorY;
+}
+
+vec3 CameraController::eye(float alpha) const {
+    return glm::mix(previousPosition, position, alpha);
+}
+
+mat4 CameraController::view(float alpha) const {
+    mat4 trans = glm::translate(mat4(1.0f), eye(alpha));
+    return inverse(trans*orientation);
+}
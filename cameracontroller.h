@@ -0,0 +1,60 @@
+#ifndef __CAMERACONTROLLER__INCLUDE__
+#define __CAMERACONTROLLER__INCLUDE__
+
+#include <glm/glm.hpp>
+
+#include "heightfield.h"
+
+using glm::mat4;
+using glm::vec2;
+using glm::vec3;
+
+// First person controls: WASD to walk, tab to fly, the mouse to look
+// around. Has no Qt widget or GL in it, so GLWidget and the render thread
+// drive the same camera.
+class CameraController {
+    public:
+        CameraController();
+
+        // Qt::Key values. Return false for keys the camera doesn't use.
+        bool keyPressed(int key);
+        bool keyReleased(int key);
+        void mousePressed(vec2 pt);
+        void mouseMoved(vec2 pt);
+
+        // What to walk on; flat at y = -.5 without one.
+        void setGround(const Heightfield *heights) { ground = heights; }
+
+        // One fixed simulation step.
+        void step(float dt);
+
+        // The camera alpha of the way from the previous step to the latest.
+        vec3 eye(float alpha) const;
+        mat4 view(float alpha) const;
+
+    private:
+        float pitch;
+        float yaw;
+        mat4 pitchMatrix;
+        mat4 yawMatrix;
+        mat4 orientation;
+
+        bool forward;
+        bool back;
+        bool left;
+        bool right;
+        bool up;
+        bool down;
+        bool fly;
+        const Heightfield *ground;
+
+        vec3 velocity;
+        vec3 position;
+        // Where the camera was one step ago. What's drawn is blended
+        // between this and position by how far into the next step we are.
+        vec3 previousPosition;
+
+        vec2 lastPt;
+};
+
+#endif
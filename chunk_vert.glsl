@@ -0,0 +1,40 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+uniform mat4 shape;
+uniform vec3 topColor;
+uniform vec3 sideColor;
+uniform vec3 bottomColor;
+// Past this the tree is an impostor and the box isn't drawn; see
+// impostors.h. 0 for never.
+uniform float impostorDistance;
+
+in vec3 position;
+in vec3 normal;
+// Per instance, see chunkstreamer.h.
+in mat4 model;
+out vec3 fcolor;
+out vec3 uPos;
+out vec3 uNorm;
+
+void main() {
+  vec4 world = model * shape * vec4(position, 1);
+  if(impostorDistance > 0 && length(cameraPosition.xyz - model[3].xyz) > impostorDistance)
+    world = model[3];
+  gl_Position = projection * view * world;
+  uPos = world.xyz;
+  // Chunk boxes are only ever moved and stretched, never turned, so
+  // their faces keep pointing the same way.
+  uNorm = normal;
+  if(normal.y > .5)
+    fcolor = topColor;
+  else if(normal.y < -.5)
+    fcolor = bottomColor;
+  else
+    fcolor = sideColor;
+}
@@ -0,0 +1,315 @@
+#include "chunkstreamer.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+const float ChunkStreamer::chunkSize = 25.0f;
+
+// Uploading stops for the frame once it's taken this long, so walking in
+// any direction never costs a frame more than this. At least one chunk
+// goes up every frame regardless.
+static const qint64 uploadBudgetNs = 500000;
+
+static uint32_t hash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// 0 to 1 from the top 24 bits.
+static float unit(uint32_t h) {
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+ChunkStreamer::ChunkStreamer() {
+    frame = 0;
+    field = 0;
+    working = 0;
+    busy = false;
+    stopping = false;
+    counts.resident = 0;
+    counts.wanted = 0;
+    counts.uploads = 0;
+    counts.evictions = 0;
+    counts.uploadNanos = 0;
+}
+
+ChunkStreamer::~ChunkStreamer() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if(loader.joinable()) {
+        loader.join();
+    }
+}
+
+void ChunkStreamer::initialize(const Mesh &cube, int slotCount) {
+    initializeOpenGLFunctions();
+
+    // Every slot is allocated up front at its largest, and that's all the
+    // memory chunks will ever take.
+    slotList.resize(std::max(1, slotCount));
+    for(size_t i = 0; i < slotList.size(); i++) {
+        Slot &slot = slotList[i];
+        slot.key = 0;
+        slot.used = false;
+        slot.lastWanted = 0;
+        slot.trees = 0;
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+        glBufferData(GL_ARRAY_BUFFER, maxTrees * sizeof(mat4), NULL, GL_STATIC_DRAW);
+        slot.treeVao = vertexArray(cube, slot.buffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    loader = std::thread(&ChunkStreamer::loaderLoop, this);
+}
+
+GLuint ChunkStreamer::vertexArray(const Mesh &cube, GLuint buffer) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, cube.positionBuffer);
+    glEnableVertexAttribArray(positionAttrib);
+    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, cube.normalBuffer);
+    glEnableVertexAttribArray(normalAttrib);
+    glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube.indexBuffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for(int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(modelAttrib + i);
+        glVertexAttribPointer(modelAttrib + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4),
+                              (void*)(sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(modelAttrib + i, 1);
+    }
+    glBindVertexArray(0);
+    return vao;
+}
+
+int64_t ChunkStreamer::keyOf(int x, int z) {
+    return (int64_t)(((uint64_t)(uint32_t)x << 32) | (uint32_t)z);
+}
+
+void ChunkStreamer::coordsOf(int64_t key, int &x, int &z) {
+    x = (int)(uint32_t)((uint64_t)key >> 32);
+    z = (int)(uint32_t)key;
+}
+
+void ChunkStreamer::generate(int64_t key, const Heightfield *ground, ChunkData &chunk) {
+    int x, z;
+    coordsOf(key, x, z);
+    float x0 = x * chunkSize;
+    float z0 = z * chunkSize;
+
+    chunk.key = key;
+    chunk.instances.clear();
+
+    // Up to maxTrees trees, kept a unit in from the edges and standing on
+    // the terrain, the cube's bottom half in it like the scene's trees on
+    // the meadow. The same chunk always gets the same ones.
+    uint32_t h = hash((uint32_t)x * 73856093u ^ hash((uint32_t)z * 19349663u));
+    int trees = (int)(h % (maxTrees + 1));
+    float low = 0, high = 0;
+    for(int i = 0; i < trees; i++) {
+        h = hash(h);
+        float tx = x0 + 1 + unit(h) * (chunkSize - 2);
+        h = hash(h);
+        float tz = z0 + 1 + unit(h) * (chunkSize - 2);
+        float ty = (ground ? ground->height(tx, tz) : -.5f) + .5f;
+        chunk.instances.push_back(glm::translate(mat4(1.0), vec3(tx, ty, tz)));
+        low = i == 0 ? ty : std::min(low, ty);
+        high = i == 0 ? ty : std::max(high, ty);
+    }
+
+    // From the bottom of the lowest trunk to the top of the highest top.
+    chunk.bounds = Aabb(vec3(x0, low - .5f, z0), vec3(x0 + chunkSize, high + 1.5f, z0 + chunkSize));
+}
+
+void ChunkStreamer::loaderLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while(true) {
+        wake.wait(guard, [this] { return stopping || !requests.empty(); });
+        if(stopping) {
+            return;
+        }
+        working = requests.front();
+        requests.erase(requests.begin());
+        busy = true;
+        const Heightfield *ground = field;
+
+        guard.unlock();
+        ChunkData chunk;
+        generate(working, ground, chunk);
+        guard.lock();
+
+        ready.push_back(std::move(chunk));
+        busy = false;
+    }
+}
+
+int ChunkStreamer::takeSlot() {
+    int oldest = -1;
+    for(size_t i = 0; i < slotList.size(); i++) {
+        if(!slotList[i].used) {
+            return (int)i;
+        }
+        if(slotList[i].lastWanted < frame && (oldest < 0 || slotList[i].lastWanted < slotList[oldest].lastWanted)) {
+            oldest = (int)i;
+        }
+    }
+    if(oldest >= 0) {
+        resident.erase(slotList[oldest].key);
+        slotList[oldest].used = false;
+        counts.evictions++;
+    }
+    return oldest;
+}
+
+bool ChunkStreamer::update(vec3 eye, float radius) {
+    frame++;
+    counts.uploads = 0;
+    counts.evictions = 0;
+    counts.uploadNanos = 0;
+
+    // Every chunk that comes within radius, nearest first, and never
+    // more than there are slots for.
+    std::vector<std::pair<float, int64_t> > wanted;
+    int x0 = (int)floorf((eye.x - radius) / chunkSize);
+    int x1 = (int)floorf((eye.x + radius) / chunkSize);
+    int z0 = (int)floorf((eye.z - radius) / chunkSize);
+    int z1 = (int)floorf((eye.z + radius) / chunkSize);
+    for(int x = x0; x <= x1; x++) {
+        for(int z = z0; z <= z1; z++) {
+            float minX = x * chunkSize, maxX = minX + chunkSize;
+            float minZ = z * chunkSize, maxZ = minZ + chunkSize;
+            if(minX >= homeArea.min.x && maxX <= homeArea.max.x &&
+               minZ >= homeArea.min.z && maxZ <= homeArea.max.z) {
+                continue;
+            }
+            float dx = std::max(0.0f, std::max(minX - eye.x, eye.x - maxX));
+            float dz = std::max(0.0f, std::max(minZ - eye.z, eye.z - maxZ));
+            float d2 = dx * dx + dz * dz;
+            if(d2 <= radius * radius) {
+                wanted.push_back(std::make_pair(d2, keyOf(x, z)));
+            }
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+    if(wanted.size() > slotList.size()) {
+        wanted.resize(slotList.size());
+    }
+    counts.wanted = (int)wanted.size();
+
+    for(size_t i = 0; i < wanted.size(); i++) {
+        std::map<int64_t, int>::iterator it = resident.find(wanted[i].second);
+        if(it != resident.end()) {
+            slotList[it->second].lastWanted = frame;
+        }
+    }
+
+    // Collect what the loader has finished and give it the new list.
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for(size_t i = 0; i < ready.size(); i++) {
+            int64_t key = ready[i].key;
+            pending[key] = std::move(ready[i]);
+        }
+        ready.clear();
+
+        requests.clear();
+        for(size_t i = 0; i < wanted.size(); i++) {
+            int64_t key = wanted[i].second;
+            if(!resident.count(key) && !pending.count(key) && !(busy && working == key)) {
+                requests.push_back(key);
+            }
+        }
+    }
+    wake.notify_one();
+
+    // Upload, nearest first, until the time's up.
+    bool changed = false;
+    QElapsedTimer timer;
+    timer.start();
+    for(size_t i = 0; i < wanted.size(); i++) {
+        std::map<int64_t, ChunkData>::iterator it = pending.find(wanted[i].second);
+        if(it == pending.end()) {
+            continue;
+        }
+        if(counts.uploads > 0 && timer.nsecsElapsed() > uploadBudgetNs) {
+            break;
+        }
+        int s = takeSlot();
+        if(s < 0) {
+            break;
+        }
+
+        const ChunkData &chunk = it->second;
+        Slot &slot = slotList[s];
+        if(!chunk.instances.empty()) {
+            glBindBuffer(GL_ARRAY_BUFFER, slot.buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, chunk.instances.size() * sizeof(mat4), &chunk.instances[0]);
+        }
+        slot.key = chunk.key;
+        slot.used = true;
+        slot.lastWanted = frame;
+        slot.trees = (GLsizei)chunk.instances.size();
+        slot.positions.clear();
+        for(size_t t = 0; t < chunk.instances.size(); t++) {
+            slot.positions.push_back(vec3(chunk.instances[t][3]));
+        }
+        slot.bounds = chunk.bounds;
+        resident[chunk.key] = s;
+        pending.erase(it);
+        counts.uploads++;
+        changed = true;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    counts.uploadNanos = timer.nsecsElapsed();
+
+    // Anything the camera has left behind since it was made is thrown
+    // away; it's cheaper to make again than to keep.
+    if(!pending.empty()) {
+        std::set<int64_t> keep;
+        for(size_t i = 0; i < wanted.size(); i++) {
+            keep.insert(wanted[i].second);
+        }
+        for(std::map<int64_t, ChunkData>::iterator it = pending.begin(); it != pending.end();) {
+            if(keep.count(it->first)) {
+                ++it;
+            } else {
+                pending.erase(it++);
+            }
+        }
+    }
+
+    counts.resident = (int)resident.size();
+    return changed || counts.evictions > 0;
+}
+
+void ChunkStreamer::setGround(const Heightfield *ground) {
+    std::lock_guard<std::mutex> guard(lock);
+    field = ground;
+}
+
+void ChunkStreamer::cull(const Frustum &frustum, std::vector<int> &visible) const {
+    for(size_t i = 0; i < slotList.size(); i++) {
+        // A chunk with no trees is still resident, so it isn't made again,
+        // but there's nothing of it to draw.
+        if(slotList[i].used && slotList[i].trees > 0 &&
+           frustum.classify(slotList[i].bounds) != Frustum::outside) {
+            visible.push_back((int)i);
+        }
+    }
+}
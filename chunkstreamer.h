@@ -0,0 +1,135 @@
+#ifndef __CHUNKSTREAMER__INCLUDE__
+#define __CHUNKSTREAMER__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "bounds.h"
+#include "heightfield.h"
+#include "resourcemanager.h"
+
+using glm::mat4;
+using glm::vec3;
+
+// The pasture past the edge of the scene, in square chunks that are made
+// up as the camera comes near them and forgotten when it's been away.
+//
+// A chunk is a few trees, boxes standing on the terrain. Which
+// chunks are wanted is worked out every frame from where the camera is.
+// The missing ones are made on a loader thread, nearest first, and each
+// frame uploads as many finished ones as fit in half a millisecond. Every
+// chunk lives in one of a fixed number of slots, a buffer of instances
+// each, so the GPU memory used never grows; when they're all taken the
+// least recently wanted chunk is evicted.
+//
+// Chunks are drawn instanced with the cube mesh and chunk_vert.glsl, one
+// instance per tree, so the trunks and the tops are two draws of the same
+// instances with different materials. The ground itself is the terrain's.
+class ChunkStreamer : protected QOpenGLFunctions_3_3_Core {
+    public:
+        struct Stats {
+            int resident;
+            int wanted;
+            int uploads;
+            int evictions;
+            // Spent uploading chunks this frame.
+            qint64 uploadNanos;
+        };
+
+        // In world units, the same as the scene's meadow.
+        static const float chunkSize;
+        static const int maxTrees = 8;
+
+        ChunkStreamer();
+        ~ChunkStreamer();
+
+        // Needs the GL context to be current. Starts the loader thread.
+        void initialize(const Mesh &cube, int slotCount);
+
+        // Chunks entirely inside home aren't made at all; that's the
+        // scene's.
+        void setHome(const Aabb &home) { homeArea = home; }
+        // The trees stand on this, read from the loader thread, so it
+        // mustn't change while chunks are being made. Chunks already
+        // made keep their trees where they were.
+        void setGround(const Heightfield *ground);
+
+        // Wants every chunk within radius of eye, asks the loader for the
+        // missing ones and uploads what it has finished. Returns whether
+        // any chunk came or went. Needs the GL context.
+        bool update(vec3 eye, float radius);
+
+        // Slots of the resident chunks at least partly in frustum.
+        void cull(const Frustum &frustum, std::vector<int> &visible) const;
+
+        GLuint treeVao(int slot) const { return slotList[slot].treeVao; }
+        GLsizei treeCount(int slot) const { return slotList[slot].trees; }
+        // Where each of them stands, the bottom of its trunk half a unit
+        // below.
+        const std::vector<vec3> &treePositions(int slot) const { return slotList[slot].positions; }
+        const Aabb &bounds(int slot) const { return slotList[slot].bounds; }
+
+        const Stats &stats() const { return counts; }
+
+    private:
+        // Made on the loader thread.
+        struct ChunkData {
+            int64_t key;
+            // One per tree.
+            std::vector<mat4> instances;
+            Aabb bounds;
+        };
+
+        struct Slot {
+            int64_t key;
+            bool used;
+            // Frame it was last wanted.
+            int lastWanted;
+            GLuint buffer;
+            GLuint treeVao;
+            GLsizei trees;
+            std::vector<vec3> positions;
+            Aabb bounds;
+        };
+
+        static int64_t keyOf(int x, int z);
+        static void coordsOf(int64_t key, int &x, int &z);
+        static void generate(int64_t key, const Heightfield *ground, ChunkData &chunk);
+
+        GLuint vertexArray(const Mesh &cube, GLuint buffer);
+        void loaderLoop();
+        // Picks a free slot, or evicts the least recently wanted chunk
+        // that isn't wanted now. -1 if every slot is wanted.
+        int takeSlot();
+
+        std::vector<Slot> slotList;
+        std::map<int64_t, int> resident;
+        Aabb homeArea;
+        int frame;
+        Stats counts;
+
+        // Finished by the loader, waiting for their turn to upload.
+        std::map<int64_t, ChunkData> pending;
+
+        // Shared with the loader thread, under lock.
+        std::mutex lock;
+        std::condition_variable wake;
+        const Heightfield *field;
+        // Nearest first; replaced every frame, so chunks the camera has
+        // left behind are never made.
+        std::vector<int64_t> requests;
+        // Being made right now, if busy.
+        int64_t working;
+        bool busy;
+        std::vector<ChunkData> ready;
+        bool stopping;
+        std::thread loader;
+};
+
+#endif
@@ -1,22 +1,53 @@
 #version 330
 
-uniform mat4 view;
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+layout(std140) uniform Shadows {
+  mat4 cascades[4];
+  vec4 texels;
+  vec4 shadowParams;
+};
 in vec3 fcolor;
 out vec4 color_out;
-uniform vec3 lightPos;
 in vec3 uPos;
-in vec3 camPos;
 in vec3 uNorm;
 uniform float ambient;
 uniform float shininess;
 uniform float speck ;
+uniform sampler2DArrayShadow shadowMap;
 
+// How much of the moonlight gets here, from 0 in shadow to 1. The
+// cascades go from smallest to largest, and the first one this is in
+// has the sharpest shadow.
+float moonlight(vec3 N) {
+        int count = int(shadowParams.x);
+        for(int c = 0; c < count; c++) {
+                vec4 p = cascades[c] * vec4(uPos, 1);
+                if(any(lessThan(p.xy, vec2(.01))) || any(greaterThan(p.xy, vec2(.99))))
+                        continue;
+                // Pushed out along the normal by a texel or so, against acne.
+                p = cascades[c] * vec4(uPos + N * texels[c] * 1.5, 1);
+                vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+                float lit = 0;
+                for(int i = 0; i < 4; i++) {
+                        vec2 offset = vec2(i & 1, i >> 1) - .5;
+                        lit += texture(shadowMap, vec4(p.xy + offset * texel, c, p.z));
+                }
+                return lit / 4;
+        }
+        return 1;
+}
 
 void main(){
         vec3 N = normalize(uNorm);
-        vec3 L = normalize(lightPos - uPos);
+        vec3 L = normalize(lightPosition.xyz - uPos);
         vec3 R = 2*dot(N,L)*N - L;
-        vec3 V = normalize(camPos- uPos);
-        color_out = vec4(fcolor * (dot(uNorm, L) + ambient) + (vec3(1,1,1) * speck *pow(clamp(dot(R,V),0,1),shininess)), 1) ;
+        vec3 V = normalize(cameraPosition.xyz - uPos);
+        float light = moonlight(N);
+        color_out = vec4(fcolor * (dot(uNorm, L) * light + ambient) + (vec3(1,1,1) * speck *pow(clamp(dot(R,V),0,1),shininess)) * light, 1) ;
 
 }
@@ -1,21 +1,39 @@
 #version 330
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
 uniform mat4 model;
+// Inverse transpose of the model matrix, worked out once per object.
+uniform mat3 normalMatrix;
+// Work normals out per vertex instead, only for the benchmark.
+uniform bool inverseNormals;
+uniform mat4 shape;
+uniform vec3 topColor;
+uniform vec3 sideColor;
+uniform vec3 bottomColor;
 
 in vec3 position;
 in vec3 normal;
-in vec3 color;
 out vec3 fcolor;
 out vec3 uPos;
 out vec3 uNorm;
-out vec3 camPos;
 
 void main() {
-  gl_Position = projection * view * model  * vec4(position, 1);
-  uPos = (model * vec4(position, 1)).xyz;
-  uNorm = (transpose(inverse(model)) * vec4(normal, 0)).xyz;
-  fcolor = color;
-  camPos = inverse(view)[3].xyz;
+  vec4 world = model * shape * vec4(position, 1);
+  gl_Position = projection * view * world;
+  uPos = world.xyz;
+  if(inverseNormals)
+    uNorm = (transpose(inverse(model)) * vec4(normal, 0)).xyz;
+  else
+    uNorm = normalMatrix * normal;
+  if(normal.y > .5)
+    fcolor = topColor;
+  else if(normal.y < -.5)
+    fcolor = bottomColor;
+  else
+    fcolor = sideColor;
 }
@@ -0,0 +1,372 @@
+#include "flock.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+const float Flock::neighbourRadius = .8f;
+
+// All in world units and seconds. A sheep is about .3 long.
+static const float separationRadius = .25f;
+static const float walkSpeed = .3f;
+static const float maxSpeed = .6f;
+static const float acceleration = 2.0f;
+static const float turnRate = 2.5f;
+static const float obstacleMargin = .4f;
+// Walk cycle radians per second at walkSpeed, about two strides a second.
+static const float strideRate = 12.0f;
+// Head up or down in about a second.
+static const float grazeRate = 1.5f;
+
+static const float separationWeight = .15f;
+static const float alignmentWeight = .5f;
+static const float cohesionWeight = .3f;
+static const float avoidWeight = 1.5f;
+
+static const float pi = 3.14159265f;
+
+// Difference between two angles, wrapped into -pi..pi.
+static float angleBetween(float from, float to) {
+    float d = to - from;
+    while(d > pi) {
+        d -= 2 * pi;
+    }
+    while(d < -pi) {
+        d += 2 * pi;
+    }
+    return d;
+}
+
+Flock::Flock() {
+    cellMask = 0;
+    tick = 0;
+    bounds.minX = bounds.minZ = -1e9f;
+    bounds.maxX = bounds.maxZ = 1e9f;
+}
+
+void Flock::clear() {
+    x.clear();
+    z.clear();
+    vx.clear();
+    vz.clear();
+    wantX.clear();
+    wantZ.clear();
+    headings.clear();
+    phases.clear();
+    paces.clear();
+    grazes.clear();
+    goals.clear();
+    timers.clear();
+    states.clear();
+    nextStates.clear();
+    movedFlags.clear();
+    seeds.clear();
+    tick = 0;
+}
+
+void Flock::add(float px, float pz, float heading) {
+    int i = size();
+    x.push_back(px);
+    z.push_back(pz);
+    vx.push_back(0);
+    vz.push_back(0);
+    wantX.push_back(0);
+    wantZ.push_back(0);
+    headings.push_back(heading);
+    phases.push_back(0);
+    paces.push_back(0);
+    grazes.push_back(1);
+    goals.push_back(heading);
+    states.push_back(grazing);
+    nextStates.push_back(grazing);
+    movedFlags.push_back(0);
+    // Same flock, same herd: seeded from the index, not the clock.
+    seeds.push_back(i * 2654435761u + 1);
+    // Spread the first change of mind out so they don't all get up at
+    // once.
+    timers.push_back(0);
+    timers[i] = 2 + 8 * random(i);
+}
+
+void Flock::setObstacles(const std::vector<Obstacle> &o) {
+    obstacles = o;
+}
+
+void Flock::setBounds(float minX, float minZ, float maxX, float maxZ) {
+    bounds.minX = minX;
+    bounds.minZ = minZ;
+    bounds.maxX = maxX;
+    bounds.maxZ = maxZ;
+}
+
+float Flock::random(int i) {
+    // xorshift32, one per sheep so thinking in parallel stays repeatable.
+    uint32_t s = seeds[i];
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    seeds[i] = s;
+    return (s >> 8) / 16777216.0f;
+}
+
+unsigned int Flock::cellHash(int cx, int cz) const {
+    return ((unsigned int)cx * 73856093u ^ (unsigned int)cz * 19349663u) & cellMask;
+}
+
+void Flock::buildGrid() {
+    int count = size();
+    unsigned int cells = 1;
+    while(cells < (unsigned int)count * 2) {
+        cells <<= 1;
+    }
+    cellMask = cells - 1;
+
+    sheepCell.resize(count);
+    JobSystem::instance().parallelFor(count, 8192, [this](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            int cx = (int)floorf(x[i] / neighbourRadius);
+            int cz = (int)floorf(z[i] / neighbourRadius);
+            sheepCell[i] = cellHash(cx, cz);
+        }
+    });
+
+    // Counting sort of the sheep by cell.
+    cellStart.assign(cells + 1, 0);
+    for(int i = 0; i < count; i++) {
+        cellStart[sheepCell[i] + 1]++;
+    }
+    for(unsigned int h = 0; h < cells; h++) {
+        cellStart[h + 1] += cellStart[h];
+    }
+    cellSheep.resize(count);
+    cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+    for(int i = 0; i < count; i++) {
+        Neighbour &n = cellSheep[cellFill[sheepCell[i]]++];
+        n.x = x[i];
+        n.z = z[i];
+        n.vx = vx[i];
+        n.vz = vz[i];
+        n.index = i;
+        n.walking = states[i] == walking;
+    }
+}
+
+void Flock::step(float dt) {
+    int count = size();
+    if(count == 0) {
+        return;
+    }
+
+    buildGrid();
+
+    JobSystem &jobs = JobSystem::instance();
+    int phase = tick % thinkInterval;
+    jobs.parallelFor(count, 1024, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            if(i % thinkInterval == phase) {
+                think(i, dt * thinkInterval);
+            }
+        }
+    });
+    jobs.parallelFor(count, 4096, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            move(i, dt);
+        }
+    });
+    tick++;
+}
+
+void Flock::think(int i, float dt) {
+    float px = x[i];
+    float pz = z[i];
+    int cx = (int)floorf(px / neighbourRadius);
+    int cz = (int)floorf(pz / neighbourRadius);
+
+    float sepX = 0, sepZ = 0;
+    float alignX = 0, alignZ = 0;
+    float centerX = 0, centerZ = 0;
+    int neighbours = 0;
+    int walkers = 0;
+
+    // Two of the nine cells can share a hash bucket; look in each bucket
+    // only once.
+    unsigned int seen[9];
+    int seenCount = 0;
+    for(int dz = -1; dz <= 1 && neighbours < maxNeighbours; dz++) {
+        for(int dx = -1; dx <= 1 && neighbours < maxNeighbours; dx++) {
+            unsigned int h = cellHash(cx + dx, cz + dz);
+            if(std::find(seen, seen + seenCount, h) != seen + seenCount) {
+                continue;
+            }
+            seen[seenCount++] = h;
+
+            for(int k = cellStart[h]; k < cellStart[h + 1] && neighbours < maxNeighbours; k++) {
+                const Neighbour &n = cellSheep[k];
+                float ox = px - n.x;
+                float oz = pz - n.z;
+                float d2 = ox * ox + oz * oz;
+                if(n.index == i || d2 > neighbourRadius * neighbourRadius) {
+                    continue;
+                }
+                if(d2 < separationRadius * separationRadius) {
+                    // Pushes harder the closer they are.
+                    float d = std::max(sqrtf(d2), .01f);
+                    sepX += ox / (d * d);
+                    sepZ += oz / (d * d);
+                }
+                alignX += n.vx;
+                alignZ += n.vz;
+                centerX += n.x;
+                centerZ += n.z;
+                neighbours++;
+                walkers += n.walking;
+            }
+        }
+    }
+
+    // Change of mind, or following the herd.
+    uint8_t state = states[i];
+    timers[i] -= dt;
+    if(timers[i] <= 0) {
+        float r = random(i);
+        if(r < .55f) {
+            state = grazing;
+            timers[i] = 4 + 8 * random(i);
+        } else if(r < .75f) {
+            state = idle;
+            timers[i] = 2 + 3 * random(i);
+            goals[i] = angleBetween(0, headings[i] + (random(i) - .5f) * pi);
+        } else {
+            state = walking;
+            timers[i] = 3 + 5 * random(i);
+            goals[i] = (random(i) * 2 - 1) * pi;
+        }
+    } else if(state != walking && walkers >= 3 && walkers * 2 > neighbours && random(i) < .05f) {
+        state = walking;
+        timers[i] = 3 + 4 * random(i);
+        goals[i] = headings[i];
+    }
+    nextStates[i] = state;
+
+    float wx = 0;
+    float wz = 0;
+    if(state == walking) {
+        // Wander a little, then follow the rules.
+        goals[i] = angleBetween(0, goals[i] + (random(i) - .5f) * .5f);
+        wx = -sinf(goals[i]) * walkSpeed;
+        wz = -cosf(goals[i]) * walkSpeed;
+        if(neighbours > 0) {
+            wx += (alignX / neighbours - vx[i]) * alignmentWeight;
+            wz += (alignZ / neighbours - vz[i]) * alignmentWeight;
+            wx += (centerX / neighbours - px) * cohesionWeight;
+            wz += (centerZ / neighbours - pz) * cohesionWeight;
+        }
+    }
+    // Even grazing sheep shuffle apart.
+    wx += sepX * separationWeight;
+    wz += sepZ * separationWeight;
+
+    for(size_t o = 0; o < obstacles.size(); o++) {
+        const Obstacle &box = obstacles[o];
+        float nx = std::min(std::max(px, box.minX), box.maxX);
+        float nz = std::min(std::max(pz, box.minZ), box.maxZ);
+        float ox = px - nx;
+        float oz = pz - nz;
+        float d2 = ox * ox + oz * oz;
+        if(d2 > obstacleMargin * obstacleMargin) {
+            continue;
+        }
+        if(d2 == 0) {
+            // Inside it: out by the nearest side.
+            float left = px - box.minX, right = box.maxX - px;
+            float back = pz - box.minZ, front = box.maxZ - pz;
+            float nearest = std::min(std::min(left, right), std::min(back, front));
+            ox = nearest == left ? -1.0f : nearest == right ? 1.0f : 0.0f;
+            oz = nearest == back ? -1.0f : nearest == front ? 1.0f : 0.0f;
+            wx += ox * maxSpeed * avoidWeight;
+            wz += oz * maxSpeed * avoidWeight;
+        } else {
+            float d = sqrtf(d2);
+            float push = (obstacleMargin - d) / obstacleMargin * maxSpeed * avoidWeight;
+            wx += ox / d * push;
+            wz += oz / d * push;
+        }
+    }
+
+    if(px < bounds.minX) wx += maxSpeed;
+    if(px > bounds.maxX) wx -= maxSpeed;
+    if(pz < bounds.minZ) wz += maxSpeed;
+    if(pz > bounds.maxZ) wz -= maxSpeed;
+
+    float speed = sqrtf(wx * wx + wz * wz);
+    if(state != walking && speed < .02f) {
+        // Not worth getting up for.
+        wx = 0;
+        wz = 0;
+    } else if(speed > maxSpeed) {
+        wx *= maxSpeed / speed;
+        wz *= maxSpeed / speed;
+    }
+    wantX[i] = wx;
+    wantZ[i] = wz;
+}
+
+void Flock::move(int i, float dt) {
+    states[i] = nextStates[i];
+    float grazeTarget = states[i] == grazing ? 1.0f : 0.0f;
+    if(wantX[i] == 0 && wantZ[i] == 0 && vx[i] == 0 && vz[i] == 0 && paces[i] == 0 &&
+       grazes[i] == grazeTarget && (states[i] != idle || headings[i] == goals[i])) {
+        // Standing still, which is what most of the flock is doing.
+        movedFlags[i] = 0;
+        return;
+    }
+
+    float k = std::min(1.0f, acceleration * dt);
+    vx[i] += (wantX[i] - vx[i]) * k;
+    vz[i] += (wantZ[i] - vz[i]) * k;
+    float speed2 = vx[i] * vx[i] + vz[i] * vz[i];
+    if(speed2 < 1e-6f) {
+        // Settled; stop drifting so standing sheep cost nothing to draw.
+        vx[i] = 0;
+        vz[i] = 0;
+    }
+
+    float heading = headings[i];
+    float target = heading;
+    if(speed2 > .02f * .02f) {
+        target = atan2f(-vx[i], -vz[i]);
+    } else if(states[i] == idle) {
+        target = goals[i];
+    }
+    float turn = angleBetween(heading, target);
+    float maxTurn = turnRate * dt;
+    if(fabsf(turn) <= maxTurn) {
+        heading = target;
+    } else {
+        heading = angleBetween(0, heading + (turn > 0 ? maxTurn : -maxTurn));
+    }
+
+    // Legs keep time with the ground covered; the head only goes down
+    // once the sheep has stopped to graze.
+    float pace = sqrtf(speed2) / walkSpeed;
+    phases[i] = fmodf(phases[i] + pace * strideRate * dt, 2 * pi);
+    float graze = grazes[i];
+    float grazeStep = grazeRate * dt;
+    if(pace > 0) {
+        grazeTarget = 0;
+    }
+    if(fabsf(grazeTarget - graze) <= grazeStep) {
+        graze = grazeTarget;
+    } else {
+        graze += graze < grazeTarget ? grazeStep : -grazeStep;
+    }
+
+    bool moving = vx[i] != 0 || vz[i] != 0 || heading != headings[i] ||
+                  pace != paces[i] || graze != grazes[i];
+    x[i] += vx[i] * dt;
+    z[i] += vz[i] * dt;
+    headings[i] = heading;
+    paces[i] = pace;
+    grazes[i] = graze;
+    movedFlags[i] = moving;
+}
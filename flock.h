@@ -0,0 +1,112 @@
+#ifndef __FLOCK__INCLUDE__
+#define __FLOCK__INCLUDE__
+
+#include <stdint.h>
+#include <vector>
+
+// Herd behaviour for the sheep, on the ground plane in world units.
+//
+// Every sheep is grazing, standing idle or walking, and changes its mind
+// every few seconds. Walking sheep steer with the usual boids rules
+// (separation, alignment and cohesion with their neighbours) and sheep
+// that see enough of their neighbours walking off tend to follow. Every
+// sheep keeps out of the obstacles (the lake, the trees) and inside the
+// bounds, and apart from the others even while grazing.
+//
+// Neighbours are found through a uniform hash grid rebuilt every step, so
+// a step costs about the same per sheep however big the flock gets. Each
+// sheep only rethinks its steering every thinkInterval steps, staggered
+// across the flock, but moves every step.
+class Flock {
+    public:
+        enum State {
+            grazing,
+            idle,
+            walking
+        };
+
+        // An axis-aligned box on the ground to keep out of.
+        struct Obstacle {
+            float minX, minZ;
+            float maxX, maxZ;
+        };
+
+        Flock();
+
+        void clear();
+        void add(float x, float z, float heading);
+        void setObstacles(const std::vector<Obstacle> &obstacles);
+        void setBounds(float minX, float minZ, float maxX, float maxZ);
+
+        void step(float dt);
+
+        int size() const { return (int)x.size(); }
+        float positionX(int i) const { return x[i]; }
+        float positionZ(int i) const { return z[i]; }
+        // Radians about +y, 0 facing -z like a freshly placed sheep.
+        float heading(int i) const { return headings[i]; }
+        State state(int i) const { return (State)states[i]; }
+        // Walk cycle for the legs, in radians, and how fast it's going
+        // through it: 0 standing, 1 at a normal walk.
+        float gaitPhase(int i) const { return phases[i]; }
+        float pace(int i) const { return paces[i]; }
+        // How far its head is down in the grass, 0 to 1.
+        float graze(int i) const { return grazes[i]; }
+        // Whether anything above changed in the last step.
+        bool moved(int i) const { return movedFlags[i] != 0; }
+
+    private:
+        static const int thinkInterval = 8;
+        // Neighbours are looked for within this, and it's the grid's cell
+        // size, so they're all in the 3x3 cells around a sheep.
+        static const float neighbourRadius;
+        // Steering looks at no more than this many neighbours; in a tight
+        // crowd the nearest few are all that matter anyway.
+        static const int maxNeighbours = 24;
+
+        void buildGrid();
+        unsigned int cellHash(int cx, int cz) const;
+        void think(int i, float dt);
+        void move(int i, float dt);
+        float random(int i);
+
+        std::vector<float> x, z;
+        std::vector<float> vx, vz;
+        // Where steering wants the velocity to go.
+        std::vector<float> wantX, wantZ;
+        std::vector<float> headings;
+        std::vector<float> phases;
+        std::vector<float> paces;
+        std::vector<float> grazes;
+        // Walking direction, or where an idle sheep is turning to look.
+        std::vector<float> goals;
+        std::vector<float> timers;
+        std::vector<uint8_t> states;
+        // Written while thinking, so neighbours still read the old state.
+        std::vector<uint8_t> nextStates;
+        std::vector<uint8_t> movedFlags;
+        std::vector<uint32_t> seeds;
+
+        // What thinking needs to know about a neighbour, copied out in
+        // cell order so a cell's sheep are next to each other in memory.
+        struct Neighbour {
+            float x, z;
+            float vx, vz;
+            int index;
+            int walking;
+        };
+
+        // Sheep sorted by cell; cell h's are cellStart[h] up to
+        // cellStart[h + 1].
+        std::vector<int> cellStart;
+        std::vector<Neighbour> cellSheep;
+        std::vector<unsigned int> sheepCell;
+        std::vector<int> cellFill;
+        unsigned int cellMask;
+
+        std::vector<Obstacle> obstacles;
+        Obstacle bounds;
+        int tick;
+};
+
+#endif
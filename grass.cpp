@@ -0,0 +1,285 @@
+#include "grass.h"
+#include "jobsystem.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+const float Grass::tileSize = 8.0f;
+const int Grass::bladesPerTile = (int)(Grass::density * Grass::tileSize * Grass::tileSize);
+const float Grass::fullDistance = 25.0f;
+const float Grass::fadeDistance = 90.0f;
+
+// The tallest a blade gets, as grass_vert.glsl makes them.
+static const float maxBladeHeight = .5f;
+
+// Making blades stops for the frame once it's taken this long; at least
+// one tile is made every frame regardless.
+static const qint64 buildBudgetNs = 1000000;
+
+// Buffers never get smaller than this many blades, so a far tile
+// creeping closer doesn't grow its buffer every few frames.
+static const int minCapacity = 1024;
+
+static uint32_t hash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static int64_t keyOf(int x, int z) {
+    return (int64_t)(((uint64_t)(uint32_t)x << 32) | (uint32_t)z);
+}
+
+Grass::Grass() {
+    field = 0;
+    prog = 0;
+    timeLoc = -1;
+    cachedBlades = 0;
+    frame = 0;
+    counts.tiles = 0;
+    counts.blades = 0;
+    counts.builds = 0;
+    counts.evictions = 0;
+    counts.buildNanos = 0;
+    counts.cachedBlades = 0;
+}
+
+float Grass::keep(float distance) {
+    return std::min(1.0f, std::max(0.0f, (fadeDistance - distance) / (fadeDistance - fullDistance)));
+}
+
+void Grass::initialize(ResourceManager &resources) {
+    initializeOpenGLFunctions();
+
+    // A blade is a tapering strip of three quads, or two and a point, one
+    // unit tall and wide at the root; the shader sizes and bends it.
+    static const vec3 points[] = {
+        vec3(-.5f, 0, 0), vec3(.5f, 0, 0),
+        vec3(-.4f, .4f, 0), vec3(.4f, .4f, 0),
+        vec3(-.22f, .75f, 0), vec3(.22f, .75f, 0),
+        vec3(0, 1, 0)
+    };
+    static const GLuint indices[] = {
+        0, 1, 2, 2, 1, 3,
+        2, 3, 4, 4, 3, 5,
+        4, 5, 6
+    };
+    std::vector<vec3> normals(7, vec3(0, 0, 1));
+    blade = resources.mesh(points, &normals[0], 7, indices, 15);
+    prog = resources.program(":/grass_vert.glsl", ":/cube_frag.glsl");
+
+    glUseProgram(prog);
+    timeLoc = glGetUniformLocation(prog, "time");
+    glUniform1f(glGetUniformLocation(prog, "bladesPerTile"), (float)bladesPerTile);
+    glUniform2f(glGetUniformLocation(prog, "fade"), fullDistance, fadeDistance);
+    glUniform2f(glGetUniformLocation(prog, "wind"), .12f, .07f);
+    glUseProgram(0);
+}
+
+void Grass::setGround(const Heightfield *ground, const std::vector<Aabb> &bare) {
+    for(std::map<int64_t, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        release(it->second);
+    }
+    tiles.clear();
+    cachedBlades = 0;
+    field = ground;
+    bareAreas = bare;
+}
+
+void Grass::release(Tile &tile) {
+    glDeleteVertexArrays(1, &tile.vao);
+    glDeleteBuffers(1, &tile.buffer);
+    cachedBlades -= tile.capacity;
+    tile.capacity = 0;
+}
+
+void Grass::build(int x, int z, Tile &tile, GLsizei count) {
+    GLsizei capacity = minCapacity;
+    while(capacity < count) {
+        capacity *= 2;
+    }
+    capacity = std::min(capacity, (GLsizei)bladesPerTile);
+
+    float x0 = x * tileSize;
+    float z0 = z * tileSize;
+    float low = tile.low;
+    float range = std::max(tile.high - tile.low, .001f);
+    uint32_t base = hash((uint32_t)x * 73856093u ^ hash((uint32_t)z * 19349663u));
+    const Heightfield *ground = field;
+    const std::vector<Aabb> &bare = bareAreas;
+
+    // Positions are rounded before the ground is looked up under them,
+    // so every blade stands exactly on it.
+    scratch.resize(capacity);
+    BladeRecord *records = &scratch[0];
+    JobSystem::instance().parallelFor(capacity, 4096, [=, &bare](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            uint32_t h = hash(base + (uint32_t)i);
+            uint16_t qx = (uint16_t)(h >> 16);
+            uint16_t qz = (uint16_t)h;
+            h = hash(h);
+            float wx = x0 + qx * (tileSize / 65535.0f);
+            float wz = z0 + qz * (tileSize / 65535.0f);
+            float wy = ground->height(wx, wz);
+
+            BladeRecord &r = records[i];
+            r.x = qx;
+            r.z = qz;
+            r.y = (uint16_t)std::min(65535.0f, std::max(0.0f, (wy - low) / range * 65535.0f + .5f));
+            r.seed = (uint16_t)((h >> 16) | 1);
+            for(size_t b = 0; b < bare.size(); b++) {
+                if(wx >= bare[b].min.x && wx <= bare[b].max.x && wz >= bare[b].min.z && wz <= bare[b].max.z) {
+                    r.seed = 0;
+                    break;
+                }
+            }
+        }
+    });
+
+    if(tile.capacity == 0) {
+        glGenBuffers(1, &tile.buffer);
+        glGenVertexArrays(1, &tile.vao);
+        glBindVertexArray(tile.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, blade.positionBuffer);
+        glEnableVertexAttribArray(positionAttrib);
+        glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, blade.indexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, tile.buffer);
+        glEnableVertexAttribArray(bladeAttrib);
+        glVertexAttribPointer(bladeAttrib, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(BladeRecord), 0);
+        glVertexAttribDivisor(bladeAttrib, 1);
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, tile.buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(BladeRecord), records, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    cachedBlades += capacity - tile.capacity;
+    tile.capacity = capacity;
+    counts.builds++;
+}
+
+void Grass::evict() {
+    if(cachedBlades <= maxCachedBlades) {
+        return;
+    }
+    std::vector<std::pair<int, int64_t> > idle;
+    for(std::map<int64_t, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        if(it->second.lastWanted < frame) {
+            idle.push_back(std::make_pair(it->second.lastWanted, it->first));
+        }
+    }
+    std::sort(idle.begin(), idle.end());
+    for(size_t i = 0; i < idle.size() && cachedBlades > maxCachedBlades; i++) {
+        std::map<int64_t, Tile>::iterator it = tiles.find(idle[i].second);
+        release(it->second);
+        tiles.erase(it);
+        counts.evictions++;
+    }
+}
+
+void Grass::update(const Frustum &frustum, vec3 eye, float time) {
+    frame++;
+    counts.blades = 0;
+    counts.builds = 0;
+    counts.evictions = 0;
+    counts.buildNanos = 0;
+    visible.clear();
+    if(!field) {
+        counts.tiles = 0;
+        return;
+    }
+
+    glUseProgram(prog);
+    glUniform1f(timeLoc, time);
+    glUseProgram(0);
+
+    // Every tile within reach that's in view, nearest first, with how
+    // many blades its distance calls for. Tiles not made yet are tested
+    // against the whole terrain's height range.
+    std::vector<std::pair<float, int64_t> > wanted;
+    std::vector<GLsizei> needed;
+    int x0 = (int)floorf((eye.x - fadeDistance) / tileSize);
+    int x1 = (int)floorf((eye.x + fadeDistance) / tileSize);
+    int z0 = (int)floorf((eye.z - fadeDistance) / tileSize);
+    int z1 = (int)floorf((eye.z + fadeDistance) / tileSize);
+    for(int x = x0; x <= x1; x++) {
+        for(int z = z0; z <= z1; z++) {
+            float minX = x * tileSize, maxX = minX + tileSize;
+            float minZ = z * tileSize, maxZ = minZ + tileSize;
+            float dx = std::max(0.0f, std::max(minX - eye.x, eye.x - maxX));
+            float dz = std::max(0.0f, std::max(minZ - eye.z, eye.z - maxZ));
+            float d = sqrtf(dx * dx + dz * dz);
+            if(d >= fadeDistance) {
+                continue;
+            }
+            int64_t key = keyOf(x, z);
+            std::map<int64_t, Tile>::iterator it = tiles.find(key);
+            float low = it != tiles.end() ? it->second.low : field->minHeight();
+            float high = it != tiles.end() ? it->second.high : field->maxHeight();
+            Aabb box(vec3(minX, low, minZ), vec3(maxX, high + maxBladeHeight, maxZ));
+            if(frustum.classify(box) == Frustum::outside) {
+                continue;
+            }
+            wanted.push_back(std::make_pair(d, key));
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    QElapsedTimer timer;
+    timer.start();
+    for(size_t i = 0; i < wanted.size(); i++) {
+        int64_t key = wanted[i].second;
+        int x = (int)(uint32_t)((uint64_t)key >> 32);
+        int z = (int)(uint32_t)key;
+        GLsizei count = (GLsizei)ceilf(keep(wanted[i].first) * bladesPerTile);
+
+        std::map<int64_t, Tile>::iterator it = tiles.find(key);
+        if(it == tiles.end()) {
+            Tile tile;
+            tile.buffer = 0;
+            tile.vao = 0;
+            tile.capacity = 0;
+            field->range(x * tileSize, z * tileSize, (x + 1) * tileSize, (z + 1) * tileSize, tile.low, tile.high);
+            it = tiles.insert(std::make_pair(key, tile)).first;
+        }
+        Tile &tile = it->second;
+        tile.lastWanted = frame;
+        if(tile.capacity < count && (counts.builds == 0 || timer.nsecsElapsed() < buildBudgetNs)) {
+            build(x, z, tile, count);
+        }
+        // Short of blades for now if it ran out of time; it'll catch up.
+        count = std::min(count, tile.capacity);
+        if(count == 0) {
+            continue;
+        }
+
+        Draw draw;
+        draw.vao = tile.vao;
+        draw.model = glm::translate(mat4(1.0f), vec3(x * tileSize, tile.low, z * tileSize)) *
+                     glm::scale(mat4(1.0f), vec3(tileSize, std::max(tile.high - tile.low, .001f), tileSize));
+        draw.count = count;
+        draw.distance = wanted[i].first;
+        visible.push_back(draw);
+        counts.blades += count;
+    }
+    counts.buildNanos = counts.builds > 0 ? timer.nsecsElapsed() : 0;
+
+    // Tiles that haven't been made yet and aren't in view don't need
+    // keeping around.
+    for(std::map<int64_t, Tile>::iterator it = tiles.begin(); it != tiles.end();) {
+        if(it->second.capacity == 0 && it->second.lastWanted < frame) {
+            tiles.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    evict();
+
+    counts.tiles = (int)visible.size();
+    counts.cachedBlades = cachedBlades;
+}
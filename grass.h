@@ -0,0 +1,130 @@
+#ifndef __GRASS__INCLUDE__
+#define __GRASS__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+#include "bounds.h"
+#include "heightfield.h"
+#include "resourcemanager.h"
+
+using glm::mat4;
+using glm::vec3;
+
+// Grass all over the terrain, millions of blades of it, thinning out with
+// distance until there's none past fadeDistance.
+//
+// The ground is split into square tiles, and a tile's blades are made up
+// from a hash of where it is: blade i is always in the same place, so the
+// first n blades of a tile are an even scattering however big n is. That
+// makes thinning free. A tile draws only as many of its blades as its
+// distance calls for, and grass_vert.glsl shrinks the last few of those
+// into the ground by each blade's own distance and widens the rest to
+// cover for the missing ones, so nothing pops.
+//
+// A tile's blades are only made when it's first in view, and kept in an
+// instance buffer of their own, 8 bytes a blade, for as long as it stays
+// in use. Coming closer makes the buffer grow, to the next power of two
+// blades. Making them is spread over the job system, nearest tile first,
+// for at most a millisecond a frame; when the cache holds more than
+// maxCachedBlades the tiles least recently in view are dropped.
+//
+// Every tile is one instanced draw of the same few triangles, placed by
+// its model matrix; the blades sway in the wind in the vertex shader.
+class Grass : protected QOpenGLFunctions_3_3_Core {
+    public:
+        struct Stats {
+            int tiles;
+            // Before the vertex shader thins them out any further.
+            int blades;
+            int builds;
+            int evictions;
+            qint64 buildNanos;
+            int cachedBlades;
+        };
+
+        // One tile's worth of blades.
+        struct Draw {
+            GLuint vao;
+            // Tile to world: its corner, its size and the height range of
+            // the ground under it.
+            mat4 model;
+            GLsizei count;
+            float distance;
+        };
+
+        static const float tileSize;
+        // Blades per square unit, as close up as the grass is thickest.
+        static const int density = 1024;
+        static const int bladesPerTile;
+        // Full density out to here, none past fadeDistance.
+        static const float fullDistance;
+        static const float fadeDistance;
+        static const int maxCachedBlades = 12 << 20;
+
+        Grass();
+
+        // Needs the GL context to be current.
+        void initialize(ResourceManager &resources);
+
+        // Grows on ground, but not within bare (the lake), in x and z.
+        // Throws away every tile made so far. Needs the GL context.
+        void setGround(const Heightfield *ground, const std::vector<Aabb> &bare);
+
+        // Picks the tiles in view of a camera at eye and makes the ones
+        // that need it. time is the wind's clock, in seconds. Needs the
+        // GL context.
+        void update(const Frustum &frustum, vec3 eye, float time);
+
+        GLuint program() const { return prog; }
+        GLsizei indexCount() const { return blade.indexCount; }
+        const std::vector<Draw> &draws() const { return visible; }
+        const Stats &stats() const { return counts; }
+
+    private:
+        // Where a blade stands in its tile, and what it looks like,
+        // normalized to 0..1. A seed of 0 is a blade that isn't there.
+        struct BladeRecord {
+            uint16_t x;
+            uint16_t y;
+            uint16_t z;
+            uint16_t seed;
+        };
+
+        struct Tile {
+            GLuint buffer;
+            GLuint vao;
+            GLsizei capacity;
+            float low;
+            float high;
+            // Frame it was last in view.
+            int lastWanted;
+        };
+
+        // How many blades of a tile this far from the camera get drawn,
+        // the same falloff as grass_vert.glsl.
+        static float keep(float distance);
+
+        void build(int x, int z, Tile &tile, GLsizei count);
+        void release(Tile &tile);
+        void evict();
+
+        const Heightfield *field;
+        std::vector<Aabb> bareAreas;
+
+        GLuint prog;
+        GLint timeLoc;
+        Mesh blade;
+
+        std::map<int64_t, Tile> tiles;
+        int cachedBlades;
+        int frame;
+        std::vector<BladeRecord> scratch;
+        std::vector<Draw> visible;
+        Stats counts;
+};
+
+#endif
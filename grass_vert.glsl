@@ -0,0 +1,59 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+// The tile: 0..1 blade positions to world.
+uniform mat4 model;
+uniform vec3 topColor;
+uniform vec3 sideColor;
+uniform float time;
+// Which way the wind blows, and how hard.
+uniform vec2 wind;
+uniform float bladesPerTile;
+// Full density out to x, none past y; see grass.h.
+uniform vec2 fade;
+
+// Blade mesh, one unit tall and wide.
+in vec3 position;
+// Per blade: where it stands in its tile and its seed, see grass.h.
+in vec4 blade;
+out vec3 fcolor;
+out vec3 uPos;
+out vec3 uNorm;
+
+void main() {
+  vec3 root = (model * vec4(blade.xyz, 1)).xyz;
+  float seed = blade.w;
+
+  // The tile draws as many blades as its nearest point calls for; each
+  // blade past what its own distance keeps sinks into the ground, and the
+  // ones left are widened to fill in for it.
+  float keep = clamp((fade.y - length(cameraPosition.xyz - root)) / (fade.y - fade.x), 0, 1);
+  float rank = float(gl_InstanceID) / bladesPerTile;
+  float grow = seed > 0 ? clamp((keep * 1.05 - rank) * 20, 0, 1) : 0;
+  float widen = min(inversesqrt(max(keep, .0625)), 4);
+
+  float angle = seed * 43.98;
+  vec2 facing = vec2(cos(angle), sin(angle));
+  vec2 across = vec2(-facing.y, facing.x);
+  float tall = (.2 + .3 * fract(seed * 97.31)) * grow;
+  float width = .025 * widen * grow;
+
+  // Bent over by its own lean and by gusts rolling across the meadow,
+  // more the higher up.
+  float gust = .5 + .5 * sin(time * 1.7 + dot(root.xz, vec2(.21, .13)) + seed * 6.28);
+  vec2 bend = facing * (.1 + .25 * fract(seed * 13.7)) + wind * (.5 + 1.5 * gust);
+  float y = position.y;
+  vec2 offset = across * position.x * width + bend * y * y * tall;
+
+  vec4 world = vec4(root.x + offset.x, root.y + y * tall, root.z + offset.y, 1);
+  gl_Position = projection * view * world;
+  uPos = world.xyz;
+  // Mostly up, so both sides light alike, tipped the way it bends.
+  uNorm = normalize(vec3(facing.x * .3 - bend.x * y, 1, facing.y * .3 - bend.y * y));
+  fcolor = mix(sideColor, topColor, y) * (.8 + .4 * fract(seed * 31.7));
+}
@@ -0,0 +1,138 @@
+#include "heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float twoPi = 6.2831853f;
+
+// The hills start this far out from the edge of the slabs, in world
+// units, and are full height this much further out again.
+static const float hillMargin = 2.0f;
+static const float hillRamp = 15.0f;
+
+// Box blur passes over the slabs, which turn their steps into slopes a
+// couple of units wide.
+static const int smoothPasses = 4;
+
+Heightfield::Heightfield() {
+    side = 0;
+    mask = 0;
+    step = 1;
+    base = -.5f;
+    lowest = base;
+    highest = base;
+}
+
+void Heightfield::build(const std::vector<Aabb> &slabs, int size, float spacing) {
+    side = size;
+    mask = size - 1;
+    step = spacing;
+    heights.assign((size_t)side * side, 0.0f);
+
+    // The biggest slab is the meadow, its top the height of all the flat
+    // ground. Everything the slabs cover is home, and stays flat.
+    Aabb home;
+    int meadow = -1;
+    float meadowArea = -1;
+    for(size_t s = 0; s < slabs.size(); s++) {
+        vec3 size3 = slabs[s].max - slabs[s].min;
+        if(size3.x * size3.z > meadowArea) {
+            meadow = (int)s;
+            meadowArea = size3.x * size3.z;
+        }
+        home.grow(slabs[s]);
+    }
+    base = meadow >= 0 ? slabs[meadow].max.y : -.5f;
+    if(meadow < 0) {
+        home = Aabb(vec3(0), vec3(0));
+    }
+
+    float period = side * step;
+    for(int j = 0; j < side; j++) {
+        // Nearest the origin of every repeat of this sample.
+        float z = (j < side / 2 ? j : j - side) * step;
+        for(int i = 0; i < side; i++) {
+            float x = (i < side / 2 ? i : i - side) * step;
+
+            float h = base;
+            for(size_t s = 0; s < slabs.size(); s++) {
+                const Aabb &b = slabs[s];
+                if(x >= b.min.x && x <= b.max.x && z >= b.min.z && z <= b.max.z) {
+                    h = std::max(h, b.max.y);
+                }
+            }
+
+            // A few waves that fit the period a whole number of times,
+            // so the hills repeat seamlessly with it.
+            float u = twoPi * x / period;
+            float v = twoPi * z / period;
+            float hills = .9f * sinf(3 * u + 1.3f) * cosf(2 * v) +
+                          .6f * sinf(5 * u + 7 * v) +
+                          .35f * cosf(11 * u - 6 * v + .4f) +
+                          .15f * sinf(23 * v + 2.1f) * sinf(17 * u);
+            float dx = std::max(0.0f, std::max(home.min.x - x, x - home.max.x));
+            float dz = std::max(0.0f, std::max(home.min.z - z, z - home.max.z));
+            float d = sqrtf(dx * dx + dz * dz);
+            float t = std::min(1.0f, std::max(0.0f, (d - hillMargin) / hillRamp));
+            h += (hills + .4f) * t * t * (3 - 2 * t);
+
+            heights[(size_t)j * side + i] = h;
+        }
+    }
+
+    std::vector<float> blurred(heights.size());
+    for(int pass = 0; pass < smoothPasses; pass++) {
+        for(int j = 0; j < side; j++) {
+            for(int i = 0; i < side; i++) {
+                float sum = 0;
+                for(int dj = -1; dj <= 1; dj++) {
+                    for(int di = -1; di <= 1; di++) {
+                        sum += sample(i + di, j + dj);
+                    }
+                }
+                blurred[(size_t)j * side + i] = sum / 9;
+            }
+        }
+        heights.swap(blurred);
+    }
+
+    lowest = highest = heights[0];
+    for(size_t k = 1; k < heights.size(); k++) {
+        lowest = std::min(lowest, heights[k]);
+        highest = std::max(highest, heights[k]);
+    }
+}
+
+float Heightfield::height(float x, float z) const {
+    if(heights.empty()) {
+        return base;
+    }
+    float fx = x / step;
+    float fz = z / step;
+    float ix = floorf(fx);
+    float iz = floorf(fz);
+    float tx = fx - ix;
+    float tz = fz - iz;
+    int i = (int)ix;
+    int j = (int)iz;
+    float a = sample(i, j) + (sample(i + 1, j) - sample(i, j)) * tx;
+    float b = sample(i, j + 1) + (sample(i + 1, j + 1) - sample(i, j + 1)) * tx;
+    return a + (b - a) * tz;
+}
+
+void Heightfield::range(float x0, float z0, float x1, float z1, float &low, float &high) const {
+    if(heights.empty()) {
+        low = high = base;
+        return;
+    }
+    int i0 = (int)floorf(x0 / step), i1 = (int)ceilf(x1 / step);
+    int j0 = (int)floorf(z0 / step), j1 = (int)ceilf(z1 / step);
+    low = high = sample(i0, j0);
+    for(int j = j0; j <= j1; j++) {
+        for(int i = i0; i <= i1; i++) {
+            float h = sample(i, j);
+            low = std::min(low, h);
+            high = std::max(high, h);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef __HEIGHTFIELD__INCLUDE__
+#define __HEIGHTFIELD__INCLUDE__
+
+#include <vector>
+
+#include "bounds.h"
+
+// Height of the ground anywhere in the world, as a square grid of samples
+// that repeats in x and z forever.
+//
+// It's built from the scene's ground slabs: the biggest one is the
+// meadow, and the others (the hill) are raised out of it and smoothed
+// into slopes. Away from the slabs the meadow rolls into low hills.
+// Looking a height up is a bilinear blend of the four samples around the
+// point, the same as terrain_vert.glsl does it, so whatever stands on
+// the terrain stands exactly on what's drawn. No GL or Qt in here; the
+// camera and the chunk loader thread read it too.
+class Heightfield {
+    public:
+        Heightfield();
+
+        // size samples a side, a power of two, spacing world units apart.
+        void build(const std::vector<Aabb> &slabs, int size, float spacing);
+
+        // O(1), anywhere. Flat at the meadow's height before build.
+        float height(float x, float z) const;
+        // Lowest and highest the ground gets over a rectangle; height
+        // never goes outside the samples around a point.
+        void range(float x0, float z0, float x1, float z1, float &low, float &high) const;
+
+        int size() const { return side; }
+        float spacing() const { return step; }
+        // side x side heights, x changing fastest; sample (i, j) is at
+        // x = i * spacing, z = j * spacing, and every period after.
+        const float *samples() const { return heights.empty() ? 0 : &heights[0]; }
+        float minHeight() const { return lowest; }
+        float maxHeight() const { return highest; }
+
+    private:
+        float sample(int i, int j) const { return heights[(j & mask) * side + (i & mask)]; }
+
+        std::vector<float> heights;
+        int side;
+        int mask;
+        float step;
+        float base;
+        float lowest;
+        float highest;
+};
+
+#endif
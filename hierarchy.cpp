@@ -0,0 +1,154 @@
+#include "hierarchy.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <glm/gtc/type_ptr.hpp>
+
+TransformHierarchy::TransformHierarchy() {
+}
+
+void TransformHierarchy::clear() {
+    parents.clear();
+    ends.clear();
+    for(int e = 0; e < 16; e++) {
+        locals[e].clear();
+    }
+    worlds.clear();
+    dirty.clear();
+    isDirty.clear();
+}
+
+void TransformHierarchy::reserve(int nodes) {
+    parents.reserve(nodes);
+    ends.reserve(nodes);
+    for(int e = 0; e < 16; e++) {
+        locals[e].reserve(nodes);
+    }
+    worlds.reserve(nodes);
+    isDirty.reserve(nodes);
+}
+
+int TransformHierarchy::add(int parent, const mat4 &local) {
+    int node = (int)parents.size();
+    assert(parent < 0 || ends[parent] == node);
+
+    parents.push_back(parent);
+    ends.push_back(node + 1);
+    for(int e = 0; e < 16; e++) {
+        locals[e].push_back(0.0f);
+    }
+    worlds.push_back(local);
+    isDirty.push_back(false);
+
+    // The new node closes every subtree it's part of.
+    for(int p = parent; p >= 0; p = parents[p]) {
+        ends[p] = node + 1;
+    }
+
+    setLocal(node, local);
+    return node;
+}
+
+void TransformHierarchy::setLocal(int node, const mat4 &local) {
+    writeLocal(node, local);
+    markDirty(node);
+}
+
+void TransformHierarchy::writeLocal(int node, const mat4 &local) {
+    const float *elements = glm::value_ptr(local);
+    for(int e = 0; e < 16; e++) {
+        locals[e][node] = elements[e];
+    }
+}
+
+void TransformHierarchy::markDirty(int node) {
+    if(!isDirty[node]) {
+        isDirty[node] = true;
+        dirty.push_back(node);
+    }
+}
+
+mat4 TransformHierarchy::local(int node) const {
+    mat4 m;
+    float *elements = glm::value_ptr(m);
+    for(int e = 0; e < 16; e++) {
+        elements[e] = locals[e][node];
+    }
+    return m;
+}
+
+int TransformHierarchy::update() {
+    if(dirty.empty()) {
+        return 0;
+    }
+
+    // In node order a dirty node's subtree can only be covered by an
+    // earlier dirty node's, so one sweep does every subtree once.
+    std::sort(dirty.begin(), dirty.end());
+
+    // Subtrees that follow on from each other are merged, so when a lot
+    // moves (a whole flock, say) the kernel gets long runs to chew on.
+    chunks.clear();
+    int recomputed = 0;
+    int first = 0;
+    int done = 0;
+    for(size_t i = 0; i < dirty.size(); i++) {
+        int node = dirty[i];
+        isDirty[node] = false;
+        if(node < done) {
+            continue;
+        }
+        if(node > done) {
+            addChunks(first, done);
+            first = node;
+        }
+        recomputed += ends[node] - node;
+        done = ends[node];
+    }
+    addChunks(first, done);
+
+    ComposeKernel compose = composeKernel();
+    JobSystem::instance().parallelFor((int)chunks.size(), 1, [&](int begin, int end) {
+        for(int c = begin; c < end; c++) {
+            updateRange(chunks[c].first, chunks[c].second, compose);
+        }
+    });
+
+    dirty.clear();
+    return recomputed;
+}
+
+void TransformHierarchy::addChunks(int first, int end) {
+    // Only cut in front of a node whose parent is outside the run, so
+    // every chunk holds whole subtrees and none of them reads a world
+    // matrix another one is writing.
+    int start = first;
+    for(int n = first; n < end; n++) {
+        if(n - start >= chunkNodes && parents[n] < first) {
+            chunks.push_back(std::make_pair(start, n));
+            start = n;
+        }
+    }
+    if(start < end) {
+        chunks.push_back(std::make_pair(start, end));
+    }
+}
+
+void TransformHierarchy::updateRange(int first, int end, ComposeKernel compose) {
+    if(first >= end) {
+        return;
+    }
+
+    MatrixStreams streams;
+    for(int e = 0; e < 16; e++) {
+        streams.elements[e] = &locals[e][0];
+    }
+    mat4 *w = &worlds[0];
+    const int *p = &parents[0];
+
+    // Parents come before their children and the kernel goes a node at
+    // a time in order, so by the time it gets to a node its parent's world
+    // matrix is already right, whether that's in this run or before it.
+    compose(w, p, streams, first, end - first, w + first);
+}
@@ -0,0 +1,76 @@
+#ifndef __HIERARCHY__INCLUDE__
+#define __HIERARCHY__INCLUDE__
+
+#include "matrixbatch.h"
+
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+using glm::mat4;
+
+// A tree of transforms with cached world matrices.
+//
+// Nodes are stored depth first: a node's children, and theirs, are added
+// straight after it, so every subtree is one contiguous run of nodes and
+// a parent always comes before its children. Changing a node's local
+// transform only marks it dirty; update then recomputes the world
+// matrices of the dirty subtrees and nothing else, so the matrix work
+// scales with what moved rather than with the size of the tree.
+//
+// Local matrices are kept as structure of arrays so update can hand whole
+// runs of nodes to the SIMD compose kernel (see matrixbatch.h) instead of
+// multiplying one pair of matrices at a time, and splits big updates into
+// chunks of whole subtrees for the job system.
+class TransformHierarchy {
+    public:
+        TransformHierarchy();
+
+        void clear();
+        void reserve(int nodes);
+
+        // parent is -1 for a root. Must be the most recently added node
+        // or one of its ancestors, to keep subtrees contiguous.
+        int add(int parent, const mat4 &local);
+
+        void setLocal(int node, const mat4 &local);
+        mat4 local(int node) const;
+
+        // setLocal in two halves, for setting a lot of nodes from several
+        // threads: writeLocal is safe to call on different nodes at once,
+        // markDirty must then be called for each of them on one thread.
+        void writeLocal(int node, const mat4 &local);
+        void markDirty(int node);
+
+        // Brings world matrices up to date, on every core if there's
+        // enough to do. Returns how many were recomputed.
+        int update();
+
+        // Only valid after update.
+        const mat4 &world(int node) const { return worlds[node]; }
+        const mat4 *worldMatrices() const { return worlds.empty() ? NULL : &worlds[0]; }
+
+        int size() const { return (int)parents.size(); }
+        int parent(int node) const { return parents[node]; }
+        // One past the last node of node's subtree.
+        int subtreeEnd(int node) const { return ends[node]; }
+
+    private:
+        std::vector<int> parents;
+        std::vector<int> ends;
+        std::vector<float> locals[16];
+        std::vector<mat4> worlds;
+
+        // Nodes per job, about; small enough to spread a big flock over
+        // all the cores, big enough to be worth handing over.
+        static const int chunkNodes = 4096;
+        std::vector<std::pair<int, int> > chunks;
+
+        void addChunks(int first, int end);
+        void updateRange(int first, int end, ComposeKernel compose);
+
+        std::vector<int> dirty;
+        std::vector<bool> isDirty;
+};
+
+#endif
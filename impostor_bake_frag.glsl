@@ -0,0 +1,15 @@
+#version 330
+
+in vec3 fcolor;
+in vec3 uPos;
+in vec3 uNorm;
+out vec4 color_out;
+// The right half of the atlas gets normals, packed into 0..1.
+uniform bool bakeNormals;
+
+void main(){
+        if(bakeNormals)
+                color_out = vec4(normalize(uNorm) * .5 + .5, 1);
+        else
+                color_out = vec4(fcolor, 1);
+}
@@ -0,0 +1,29 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+in vec2 colorUv;
+in vec2 normalUv;
+in vec3 uPos;
+in float fade;
+out vec4 color_out;
+uniform sampler2D atlas;
+uniform float ambient;
+
+// A 4x4 ordered dither, so a tree fading in covers more of the same
+// pixels every frame instead of sparkling, and needs no sorting.
+const float dither[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+
+void main(){
+        vec4 albedo = texture(atlas, colorUv);
+        ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+        if(albedo.a < .5 || fade <= dither[p.y * 4 + p.x] / 16)
+                discard;
+        vec3 N = normalize(texture(atlas, normalUv).xyz * 2 - 1);
+        vec3 L = normalize(lightPosition.xyz - uPos);
+        color_out = vec4(albedo.rgb * (dot(N, L) + ambient), 1);
+}
@@ -0,0 +1,45 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+// Half width, bottom and top of every picture around where the tree
+// stands, and how many pictures; see impostors.h.
+uniform vec4 frameBox;
+// Dithers in from x to y.
+uniform vec2 fadeRange;
+
+// Quad corner, -.5..5 across and 0..1 up.
+in vec3 position;
+// Per tree, where it stands.
+in vec3 tree;
+out vec2 colorUv;
+out vec2 normalUv;
+out vec3 uPos;
+out float fade;
+
+void main() {
+  vec3 toCamera = cameraPosition.xyz - tree;
+  vec2 facing = normalize(toCamera.xz + vec2(1e-5, 0));
+
+  // The picture taken from nearest the camera's direction; picture k was
+  // taken from 2 pi k / views round from +x.
+  float views = frameBox.w;
+  float k = mod(floor(atan(facing.y, facing.x) / 6.2831853 * views + .5), views);
+  vec2 cell = vec2(mod(k, 4), floor(k / 4));
+  vec2 uv = position.xy + vec2(.5, 0);
+  colorUv = (cell + uv) / vec2(8, 4);
+  normalUv = colorUv + vec2(.5, 0);
+
+  // Turned about the vertical to face the camera, as lookAt turns the
+  // baking camera.
+  vec3 right = vec3(facing.y, 0, -facing.x);
+  vec3 world = tree + right * position.x * 2 * frameBox.x +
+               vec3(0, mix(frameBox.y, frameBox.z, position.y), 0);
+  gl_Position = projection * view * vec4(world, 1);
+  uPos = world;
+  fade = clamp((length(toCamera) - fadeRange.x) / (fadeRange.y - fadeRange.x), 0, 1);
+}
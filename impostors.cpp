@@ -0,0 +1,187 @@
+#include "impostors.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "bounds.h"
+
+using glm::vec2;
+
+const float Impostors::fadeStart = 30.0f;
+const float Impostors::fadeEnd = 40.0f;
+
+// The atlas is this many pictures a side, twice over side by side.
+static const int gridSide = 4;
+
+static const float twoPi = 6.2831853f;
+
+// Mirrors the Camera block, for baking.
+struct BakeCamera {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPos;
+    vec4 lightPos;
+};
+
+Impostors::Impostors() {
+    prog = 0;
+    bakeProg = 0;
+    vao = 0;
+    treeBuffer = 0;
+    trees = 0;
+    atlas = 0;
+    frame = vec4(1, 0, 1, views);
+}
+
+void Impostors::initialize(ResourceManager &resources) {
+    initializeOpenGLFunctions();
+
+    static const vec3 corners[] = {
+        vec3(-.5f, 0, 0), vec3(.5f, 0, 0), vec3(-.5f, 1, 0), vec3(.5f, 1, 0)
+    };
+    static const vec3 normals[] = {
+        vec3(0, 0, 1), vec3(0, 0, 1), vec3(0, 0, 1), vec3(0, 0, 1)
+    };
+    static const GLuint indices[] = { 0, 1, 2, 2, 1, 3 };
+    quad = resources.mesh(corners, normals, 4, indices, 6);
+    prog = resources.program(":/impostor_vert.glsl", ":/impostor_frag.glsl");
+    bakeProg = resources.program(":/cube_vert.glsl", ":/impostor_bake_frag.glsl");
+
+    glGenBuffers(1, &treeBuffer);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quad.positionBuffer);
+    glEnableVertexAttribArray(positionAttrib);
+    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad.indexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, treeBuffer);
+    glEnableVertexAttribArray(treeAttrib);
+    glVertexAttribPointer(treeAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribDivisor(treeAttrib, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2 * gridSide * cellSize, gridSide * cellSize, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "atlas"), 0);
+    glUniform2f(glGetUniformLocation(prog, "fadeRange"), fadeStart, fadeEnd);
+    glUseProgram(0);
+}
+
+void Impostors::bake(const Mesh &cube, const Material *const *parts, int partCount) {
+    // Every picture frames the whole tree, with a little room round it
+    // so the mipmaps of one don't bleed into the next.
+    Aabb box;
+    for(int i = 0; i < partCount; i++) {
+        Aabb part = Aabb(vec3(-.5f), vec3(.5f)).transformed(parts[i]->shape);
+        if(i == 0) {
+            box = part;
+        } else {
+            box.grow(part);
+        }
+    }
+    float halfWidth = std::max(glm::length(vec2(box.min.x, box.min.z)), glm::length(vec2(box.max.x, box.max.z)));
+    float margin = (box.max.y - box.min.y) * .05f;
+    frame = vec4(halfWidth + margin, box.min.y - margin, box.max.y + margin, views);
+
+    GLint oldFbo;
+    GLint oldViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &oldFbo);
+    glGetIntegerv(GL_VIEWPORT, oldViewport);
+
+    GLuint fbo, depth;
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 2 * gridSide * cellSize, gridSide * cellSize);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    GLuint cameraBuffer;
+    glGenBuffers(1, &cameraBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(BakeCamera), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cameraBuffer);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glPrimitiveRestartIndex(0xFFFFFFFF);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(bakeProg);
+    glUniformMatrix4fv(glGetUniformLocation(bakeProg, "model"), 1, false, glm::value_ptr(mat4(1.0f)));
+    glUniformMatrix3fv(glGetUniformLocation(bakeProg, "normalMatrix"), 1, false, glm::value_ptr(mat3(1.0f)));
+    GLint shapeLoc = glGetUniformLocation(bakeProg, "shape");
+    GLint topLoc = glGetUniformLocation(bakeProg, "topColor");
+    GLint sideLoc = glGetUniformLocation(bakeProg, "sideColor");
+    GLint bottomLoc = glGetUniformLocation(bakeProg, "bottomColor");
+    GLint normalsLoc = glGetUniformLocation(bakeProg, "bakeNormals");
+    glBindVertexArray(cube.vao);
+
+    // Picture k is taken from the direction angle 2 pi k / views round
+    // from +x, which is how impostor_vert.glsl picks it.
+    mat4 projection = glm::ortho(-frame.x, frame.x, frame.y, frame.z, .1f, 20.0f);
+    for(int k = 0; k < views; k++) {
+        float angle = twoPi * k / views;
+        vec3 from(cosf(angle), 0, sinf(angle));
+        BakeCamera camera;
+        camera.projection = projection;
+        camera.view = glm::lookAt(from * 10.0f, vec3(0), vec3(0, 1, 0));
+        camera.cameraPos = vec4(from * 10.0f, 1);
+        camera.lightPos = vec4(0, 100, 0, 1);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(BakeCamera), &camera);
+
+        for(int half = 0; half < 2; half++) {
+            glViewport(((k % gridSide) + half * gridSide) * cellSize, (k / gridSide) * cellSize, cellSize, cellSize);
+            glUniform1i(normalsLoc, half);
+            for(int i = 0; i < partCount; i++) {
+                glUniformMatrix4fv(shapeLoc, 1, false, glm::value_ptr(parts[i]->shape));
+                glUniform3fv(topLoc, 1, glm::value_ptr(parts[i]->topColor));
+                glUniform3fv(sideLoc, 1, glm::value_ptr(parts[i]->sideColor));
+                glUniform3fv(bottomLoc, 1, glm::value_ptr(parts[i]->bottomColor));
+                glDrawElements(GL_TRIANGLE_FAN, cube.indexCount, GL_UNSIGNED_INT, 0);
+            }
+        }
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFbo);
+    glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depth);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glDeleteBuffers(1, &cameraBuffer);
+
+    glUseProgram(prog);
+    glUniform4fv(glGetUniformLocation(prog, "frameBox"), 1, glm::value_ptr(frame));
+    glUseProgram(0);
+}
+
+void Impostors::setTrees(const std::vector<vec3> &positions) {
+    trees = (GLsizei)positions.size();
+    glBindBuffer(GL_ARRAY_BUFFER, treeBuffer);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(vec3), positions.empty() ? NULL : &positions[0],
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,64 @@
+#ifndef __IMPOSTORS__INCLUDE__
+#define __IMPOSTORS__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "renderqueue.h"
+#include "resourcemanager.h"
+
+using glm::vec3;
+using glm::vec4;
+
+// Far away trees as flat pictures of themselves.
+//
+// At startup bake draws a tree, its trunk and its top, from views
+// directions all the way round into an atlas: a grid of pictures of its
+// colour on the left half and of its normals on the right, so the
+// pictures can still be lit by the moon. Past fadeStart a tree is also
+// drawn as a quad turned to face the camera, showing whichever picture
+// was taken from nearest the camera's direction; it dithers in by fadeEnd,
+// where chunk_vert.glsl drops the boxes. All of the far trees together are
+// one instanced draw.
+class Impostors : protected QOpenGLFunctions_3_3_Core {
+    public:
+        static const int views = 16;
+        // Pixels a side of each picture.
+        static const int cellSize = 128;
+        static const float fadeStart;
+        static const float fadeEnd;
+
+        Impostors();
+
+        // Needs the GL context to be current.
+        void initialize(ResourceManager &resources);
+
+        // Draws the parts, the cube mesh fitted and coloured by each
+        // material, into the atlas. Binds its own Camera block and puts
+        // the framebuffer and viewport back the way they were.
+        void bake(const Mesh &cube, const Material *const *parts, int partCount);
+
+        // The trees to draw this way, where they stand as chunk trees do.
+        void setTrees(const std::vector<vec3> &positions);
+
+        GLuint program() const { return prog; }
+        GLuint vertexArray() const { return vao; }
+        GLuint texture() const { return atlas; }
+        GLsizei indexCount() const { return quad.indexCount; }
+        GLsizei count() const { return trees; }
+
+    private:
+        GLuint prog;
+        GLuint bakeProg;
+        Mesh quad;
+        GLuint vao;
+        GLuint treeBuffer;
+        GLsizei trees;
+        GLuint atlas;
+        // The pictures' half width, and their bottom and top, around where
+        // a tree stands.
+        vec4 frame;
+};
+
+#endif
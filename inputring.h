@@ -0,0 +1,66 @@
+#ifndef __INPUTRING__INCLUDE__
+#define __INPUTRING__INCLUDE__
+
+#include <atomic>
+
+// One input event handed from the GUI thread to the render thread.
+struct InputEvent {
+    enum Type {
+        KeyPress,
+        KeyRelease,
+        MousePress,
+        MouseMove,
+        Resize
+    };
+
+    Type type;
+    // Qt::Key for key events.
+    int key;
+    // Cursor position for mouse events, framebuffer size for Resize.
+    int x;
+    int y;
+};
+
+// Single producer, single consumer ring of input events. The GUI thread
+// pushes, the render thread pops, and neither ever takes a lock or waits
+// on the other. When the render thread falls behind far enough to fill
+// it, new events are dropped rather than blocking the GUI.
+class InputRing {
+    public:
+        InputRing() : head(0), tail(0) {}
+
+        // GUI thread only.
+        bool push(const InputEvent &event) {
+            unsigned int h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == capacity) {
+                return false;
+            }
+            events[h & (capacity - 1)] = event;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Render thread only.
+        bool pop(InputEvent &event) {
+            unsigned int t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            event = events[t & (capacity - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        // Must be a power of two. Counters wrap around cleanly since they
+        // are unsigned.
+        static const unsigned int capacity = 1024;
+
+        InputEvent events[capacity];
+        // Kept on separate cache lines so the two threads don't fight
+        // over one.
+        alignas(64) std::atomic<unsigned int> head;
+        alignas(64) std::atomic<unsigned int> tail;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+static int requestedWorkers = -1;
+
+// Which queue the current thread pushes to and pops from.
+static thread_local int currentQueue = 0;
+
+JobSystem &JobSystem::instance() {
+    static JobSystem system(requestedWorkers);
+    return system;
+}
+
+void JobSystem::setWorkerCount(int workers) {
+    requestedWorkers = workers;
+}
+
+JobSystem::JobSystem(int count) {
+    if(count < 0) {
+        count = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+
+    queued.store(0);
+    stopping = false;
+    for(int i = 0; i <= count; i++) {
+        queues.push_back(new Queue());
+    }
+    for(int i = 0; i < count; i++) {
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, i + 1));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    for(size_t i = 0; i < queues.size(); i++) {
+        delete queues[i];
+    }
+}
+
+void JobSystem::parallelFor(int count, int grain, const std::function<void(int, int)> &body) {
+    if(count <= 0) {
+        return;
+    }
+    grain = std::max(grain, 1);
+    int chunks = (count + grain - 1) / grain;
+    if(workers.empty() || chunks == 1) {
+        body(0, count);
+        return;
+    }
+
+    std::atomic<int> pending(chunks);
+    int queue = currentQueue;
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->lock);
+        for(int c = 0; c < chunks; c++) {
+            Job job;
+            job.body = &body;
+            job.begin = c * grain;
+            job.end = std::min(count, job.begin + grain);
+            job.pending = &pending;
+            queues[queue]->jobs.push_back(job);
+        }
+    }
+    {
+        // Taking the lock means no worker can be between finding nothing
+        // to do and going to sleep, so none of them misses this.
+        std::lock_guard<std::mutex> lock(sleepLock);
+        queued.fetch_add(chunks);
+    }
+    wake.notify_all();
+
+    // Help out until every chunk is done. The jobs run here needn't be
+    // ours, which is fine, they're all somebody's frame.
+    while(pending.load(std::memory_order_acquire) > 0) {
+        Job job;
+        if(pop(queue, job) || steal(queue, job)) {
+            run(job);
+        } else {
+            // The last chunks are running on other threads.
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::workerLoop(int queue) {
+    currentQueue = queue;
+    while(true) {
+        Job job;
+        if(pop(queue, job) || steal(queue, job)) {
+            run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepLock);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if(stopping) {
+            return;
+        }
+    }
+}
+
+bool JobSystem::pop(int queue, Job &job) {
+    Queue *q = queues[queue];
+    std::lock_guard<std::mutex> lock(q->lock);
+    if(q->jobs.empty()) {
+        return false;
+    }
+    job = q->jobs.back();
+    q->jobs.pop_back();
+    queued.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::steal(int thief, Job &job) {
+    int count = (int)queues.size();
+    for(int i = 1; i < count; i++) {
+        Queue *q = queues[(thief + i) % count];
+        std::lock_guard<std::mutex> lock(q->lock);
+        if(!q->jobs.empty()) {
+            job = q->jobs.front();
+            q->jobs.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(const Job &job) {
+    (*job.body)(job.begin, job.end);
+    job.pending->fetch_sub(1, std::memory_order_release);
+}
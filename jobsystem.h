@@ -0,0 +1,77 @@
+#ifndef __JOBSYSTEM__INCLUDE__
+#define __JOBSYSTEM__INCLUDE__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job scheduler for spreading the CPU side of a frame over
+// every core.
+//
+// Each worker thread has its own deque of jobs. It works from the back of
+// its own deque, on whatever it split up most recently and still has in
+// cache, and when that runs dry it steals from the front of another one.
+// Threads that aren't workers (the GUI thread, or the render thread)
+// share one more deque. Waiting never just blocks: a thread waiting on
+// its jobs runs queued jobs itself until they're done, so the thread
+// that makes the GL calls helps build its own frame instead of sitting
+// idle.
+class JobSystem {
+    public:
+        // The one everything shares, started on first use.
+        static JobSystem &instance();
+        // Only has an effect before the first instance() call. Negative
+        // means one fewer than the number of cores, so the workers and
+        // the calling thread fill the machine; 0 runs everything on the
+        // calling thread.
+        static void setWorkerCount(int workers);
+
+        ~JobSystem();
+
+        int workerCount() const { return (int)workers.size(); }
+
+        // Calls body(begin, end) on chunks of about grain items covering
+        // [0, count), on whatever threads are free, and returns once every
+        // chunk is done. body must be safe to run on several threads at
+        // once; it may call parallelFor itself.
+        void parallelFor(int count, int grain, const std::function<void(int, int)> &body);
+
+    private:
+        struct Job {
+            const std::function<void(int, int)> *body;
+            int begin;
+            int end;
+            std::atomic<int> *pending;
+        };
+
+        struct Queue {
+            std::mutex lock;
+            std::deque<Job> jobs;
+        };
+
+        JobSystem(int workers);
+        JobSystem(const JobSystem &);
+        JobSystem &operator=(const JobSystem &);
+
+        void workerLoop(int queue);
+        bool pop(int queue, Job &job);
+        bool steal(int thief, Job &job);
+        void run(const Job &job);
+
+        // queues[0] belongs to every thread that isn't a worker, worker i
+        // owns queues[i + 1].
+        std::vector<Queue *> queues;
+        std::vector<std::thread> workers;
+
+        // Jobs sitting in any queue; idle workers sleep while it's 0.
+        std::atomic<int> queued;
+        std::mutex sleepLock;
+        std::condition_variable wake;
+        bool stopping;
+};
+
+#endif
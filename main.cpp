@@ -1,6 +1,12 @@
 #include <QApplication>
+#include <QCommandLineParser>
 
+#include "benchmark.h"
 #include "glwidget.h"
+#include "jobsystem.h"
+#include "renderer.h"
+#include "renderwindow.h"
+#include "scene.h"
 
 int main(int argc, char** argv) {
     QApplication a(argc, argv);
@@ -10,7 +16,124 @@ int main(int argc, char** argv) {
     format.setProfile(QSurfaceFormat::CoreProfile);
     QSurfaceFormat::setDefaultFormat(format);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption sceneOption("scene", "Scene to load, text or binary.", "file", ":/sheep.scene");
+    QCommandLineOption writeSceneOption("write-scene",
+        "Write the scene (or with --stress, the stress flock) as a binary scene and exit.", "file");
+    QCommandLineOption uncappedOption("uncapped", "Turn off vsync and draw as fast as possible.");
+    QCommandLineOption renderThreadOption("render-thread",
+        "Draw on a separate render thread instead of the GUI thread.");
+    QCommandLineOption benchmarkOption("benchmark",
+        "Render headless along a fixed camera path and write frame timings.");
+    QCommandLineOption framesOption("frames", "Number of benchmark frames.", "n", "600");
+    QCommandLineOption warmupOption("warmup", "Frames left out of the summary.", "n", "10");
+    QCommandLineOption sizeOption("size", "Benchmark framebuffer size.", "WxH", "1280x720");
+    QCommandLineOption stressOption("stress", "Benchmark the 50k sheep stress flock.");
+    QCommandLineOption denseFieldOption("dense-field",
+        "Benchmark circling low over the stress flock, vertex bound.");
+    QCommandLineOption inverseNormalsOption("inverse-normals",
+        "Benchmark with normals from a per-vertex matrix inverse, to compare.");
+    QCommandLineOption csvOption("csv", "Per-frame CSV output.", "file", "benchmark.csv");
+    QCommandLineOption jsonOption("json", "Summary and per-frame JSON output.", "file", "benchmark.json");
+    QCommandLineOption traceOption("trace", "Chrome trace of the benchmark's profiler scopes.", "file");
+    QCommandLineOption threadsOption("threads",
+        "Worker threads for simulation and culling, 0 for none. Defaults to one fewer than the cores.", "n");
+    QCommandLineOption shadowCascadesOption("shadow-cascades",
+        "Shadow cascades for the moonlight, 0 to 4, 0 for no shadows.", "n", "3");
+    QCommandLineOption shadowSizeOption("shadow-size", "Size of each shadow cascade's map.", "texels", "1024");
+    QCommandLineOption particlesOption("particles", "Fireflies, mist and leaves, all told.", "n", "200000");
+    QCommandLineOption cpuParticlesOption("cpu-particles",
+        "Move the particles on the CPU with SIMD instead of with transform feedback, to compare.");
+    QCommandLineOption benchTransformsOption("bench-transforms",
+        "Time the SIMD transform kernels against glm on a synthetic hierarchy with n roots and exit.", "n");
+    parser.addOption(sceneOption);
+    parser.addOption(writeSceneOption);
+    parser.addOption(uncappedOption);
+    parser.addOption(renderThreadOption);
+    parser.addOption(benchmarkOption);
+    parser.addOption(framesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(sizeOption);
+    parser.addOption(stressOption);
+    parser.addOption(denseFieldOption);
+    parser.addOption(inverseNormalsOption);
+    parser.addOption(csvOption);
+    parser.addOption(jsonOption);
+    parser.addOption(traceOption);
+    parser.addOption(threadsOption);
+    parser.addOption(shadowCascadesOption);
+    parser.addOption(shadowSizeOption);
+    parser.addOption(particlesOption);
+    parser.addOption(cpuParticlesOption);
+    parser.addOption(benchTransformsOption);
+    parser.process(a);
+
+    if(parser.isSet(threadsOption)) {
+        JobSystem::setWorkerCount(parser.value(threadsOption).toInt());
+    }
+    Renderer::setDefaultShadows(parser.value(shadowCascadesOption).toInt(),
+                                parser.value(shadowSizeOption).toInt());
+    Renderer::setDefaultParticles(parser.value(particlesOption).toInt(), parser.isSet(cpuParticlesOption));
+
+    QString scenePath = parser.value(sceneOption);
+
+    if(parser.isSet(writeSceneOption)) {
+        Scene scene;
+        if(parser.isSet(stressOption)) {
+            scene.generateFlock(224);
+        } else if(!scene.load(scenePath)) {
+            return 1;
+        }
+        return scene.saveBinary(parser.value(writeSceneOption)) ? 0 : 1;
+    }
+
+    if(parser.isSet(benchTransformsOption)) {
+        int sheep = parser.value(benchTransformsOption).toInt();
+        if(sheep <= 0) {
+            parser.showHelp(1);
+        }
+        return Benchmark::runTransforms(sheep, 50);
+    }
+
+    if(parser.isSet(benchmarkOption)) {
+        Benchmark::Options options;
+        options.frames = parser.value(framesOption).toInt();
+        options.warmup = parser.value(warmupOption).toInt();
+        QStringList size = parser.value(sizeOption).split('x');
+        options.width = size.value(0).toInt();
+        options.height = size.value(1).toInt();
+        options.stress = parser.isSet(stressOption);
+        options.denseField = parser.isSet(denseFieldOption);
+        options.inverseNormals = parser.isSet(inverseNormalsOption);
+        options.scenePath = scenePath;
+        options.csvPath = parser.value(csvOption);
+        options.jsonPath = parser.value(jsonOption);
+        options.tracePath = parser.value(traceOption);
+
+        if(options.frames <= 0 || options.width <= 0 || options.height <= 0) {
+            parser.showHelp(1);
+        }
+
+        Benchmark benchmark(options);
+        return benchmark.run();
+    }
+
+    if(parser.isSet(uncappedOption)) {
+        format.setSwapInterval(0);
+        QSurfaceFormat::setDefaultFormat(format);
+    }
+
+    if(parser.isSet(renderThreadOption)) {
+        RenderWindow window(scenePath);
+        window.setFormat(format);
+        window.resize(800, 600);
+        window.show();
+        return a.exec();
+    }
+
     GLWidget glwidget;
+    glwidget.setScenePath(scenePath);
     glwidget.show();
 
     return a.exec();
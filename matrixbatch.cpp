@@ -0,0 +1,181 @@
+#include "matrixbatch.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define MATRIXBATCH_SSE
+#endif
+
+// GCC and Clang can build the AVX2 kernel into an otherwise baseline
+// binary and pick it at run time.
+#if defined(MATRIXBATCH_SSE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define MATRIXBATCH_AVX2
+#endif
+
+static const mat4 identity(1.0f);
+
+// The intrinsic stores may alias anything, so the stream pointers get
+// reloaded after every one of them unless they're copied somewhere the
+// compiler can see nothing else points at.
+struct StreamPointers {
+    const float *e[16];
+
+    StreamPointers(const MatrixStreams &streams) {
+        for(int i = 0; i < 16; i++) {
+            e[i] = streams.elements[i];
+        }
+    }
+    const float *operator[](int i) const { return e[i]; }
+};
+
+static const float *parentOf(const mat4 *parentWorlds, int parent) {
+    return glm::value_ptr(parent >= 0 ? parentWorlds[parent] : identity);
+}
+
+static void composeScalarKernel(const mat4 *parentWorlds, const int *parents,
+                                const MatrixStreams &locals, int first, int count, mat4 *out) {
+    for(int i = 0; i < count; i++) {
+        int n = first + i;
+        // Copied so writing out can't alias the parent, which could be
+        // in the same array.
+        float p[16];
+        float l[16];
+        const float *parent = parentOf(parentWorlds, parents[n]);
+        for(int e = 0; e < 16; e++) {
+            p[e] = parent[e];
+            l[e] = locals.elements[e][n];
+        }
+
+        float *o = glm::value_ptr(out[i]);
+        for(int c = 0; c < 4; c++) {
+            for(int r = 0; r < 4; r++) {
+                o[c * 4 + r] = p[r] * l[c * 4] + p[4 + r] * l[c * 4 + 1] +
+                               p[8 + r] * l[c * 4 + 2] + p[12 + r] * l[c * 4 + 3];
+            }
+        }
+    }
+}
+
+#ifdef MATRIXBATCH_SSE
+
+// The SIMD kernels go a node at a time, a column to a register: column c
+// of the result is the parent's columns weighted by column c of the local.
+// Those weights come straight out of the streams as broadcasts, so nothing
+// needs shuffling into or out of the usual mat4 layout. Vectorizing across
+// nodes instead needs a 16x8 transpose each way per batch, and measured a
+// good deal slower than this.
+static void composeSseKernel(const mat4 *parentWorlds, const int *parents,
+                             const MatrixStreams &locals, int first, int count, mat4 *out) {
+    StreamPointers l(locals);
+
+    for(int i = 0; i < count; i++) {
+        int n = first + i;
+        const float *parent = parentOf(parentWorlds, parents[n]);
+        __m128 p0 = _mm_loadu_ps(parent);
+        __m128 p1 = _mm_loadu_ps(parent + 4);
+        __m128 p2 = _mm_loadu_ps(parent + 8);
+        __m128 p3 = _mm_loadu_ps(parent + 12);
+
+        float *o = glm::value_ptr(out[i]);
+        for(int c = 0; c < 4; c++) {
+            __m128 col = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(l[c * 4][n])),
+                                               _mm_mul_ps(p1, _mm_set1_ps(l[c * 4 + 1][n]))),
+                                    _mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(l[c * 4 + 2][n])),
+                                               _mm_mul_ps(p3, _mm_set1_ps(l[c * 4 + 3][n]))));
+            _mm_storeu_ps(o + c * 4, col);
+        }
+    }
+}
+
+#endif
+
+#ifdef MATRIXBATCH_AVX2
+
+// Two columns of the result per register: every parent column sits in both
+// halves, the low half weighted for column c and the high for column c + 1.
+__attribute__((target("avx2,fma")))
+static inline __m256 weights(const StreamPointers &l, int c, int k, int n) {
+    return _mm256_blend_ps(_mm256_broadcast_ss(l[c * 4 + k] + n),
+                           _mm256_broadcast_ss(l[c * 4 + 4 + k] + n), 0xf0);
+}
+
+__attribute__((target("avx2,fma")))
+static void composeAvx2Kernel(const mat4 *parentWorlds, const int *parents,
+                              const MatrixStreams &locals, int first, int count, mat4 *out) {
+    StreamPointers l(locals);
+
+    for(int i = 0; i < count; i++) {
+        int n = first + i;
+        const float *parent = parentOf(parentWorlds, parents[n]);
+        __m256 p0 = _mm256_broadcast_ps((const __m128 *)parent);
+        __m256 p1 = _mm256_broadcast_ps((const __m128 *)(parent + 4));
+        __m256 p2 = _mm256_broadcast_ps((const __m128 *)(parent + 8));
+        __m256 p3 = _mm256_broadcast_ps((const __m128 *)(parent + 12));
+
+        float *o = glm::value_ptr(out[i]);
+        for(int c = 0; c < 4; c += 2) {
+            __m256 cols = _mm256_mul_ps(p0, weights(l, c, 0, n));
+            cols = _mm256_fmadd_ps(p1, weights(l, c, 1, n), cols);
+            cols = _mm256_fmadd_ps(p2, weights(l, c, 2, n), cols);
+            cols = _mm256_fmadd_ps(p3, weights(l, c, 3, n), cols);
+            _mm256_storeu_ps(o + c * 4, cols);
+        }
+    }
+}
+
+#endif
+
+ComposeKernel composeKernel(ComposeLevel level) {
+    switch(level) {
+        case composeScalar:
+            return composeScalarKernel;
+        case composeSse:
+#ifdef MATRIXBATCH_SSE
+            return composeSseKernel;
+#else
+            return NULL;
+#endif
+        case composeAvx2:
+#ifdef MATRIXBATCH_AVX2
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return composeAvx2Kernel;
+            }
+#endif
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+ComposeLevel composeLevel() {
+    static ComposeLevel best = composeLevelCount;
+    if(best == composeLevelCount) {
+        best = composeScalar;
+        for(int level = composeScalar; level < composeLevelCount; level++) {
+            if(composeKernel((ComposeLevel)level)) {
+                best = (ComposeLevel)level;
+            }
+        }
+    }
+    return best;
+}
+
+ComposeKernel composeKernel() {
+    static ComposeKernel best = composeKernel(composeLevel());
+    return best;
+}
+
+const char *composeLevelName(ComposeLevel level) {
+    switch(level) {
+        case composeScalar:
+            return "scalar";
+        case composeSse:
+            return "sse";
+        case composeAvx2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef __MATRIXBATCH__INCLUDE__
+#define __MATRIXBATCH__INCLUDE__
+
+#include <glm/glm.hpp>
+
+using glm::mat4;
+
+// Local matrices kept as structure of arrays: element e of node n's
+// matrix is elements[e][n], where e = column * 4 + row as in glm. A batch
+// of consecutive nodes' matrices then loads as one vector per element.
+struct MatrixStreams {
+    float *elements[16];
+};
+
+// out[i] = parentWorlds[parents[first + i]] * local(first + i), for count
+// consecutive nodes. A parent of -1 means the identity. out is an array of
+// count plain mat4s and may be the nodes' own slots in parentWorlds, or
+// somewhere else entirely such as a mapped instance buffer. Nodes are done
+// one at a time in order, so with out in parentWorlds a parent earlier in
+// the same run is used as just computed.
+typedef void (*ComposeKernel)(const mat4 *parentWorlds, const int *parents,
+                              const MatrixStreams &locals, int first, int count, mat4 *out);
+
+enum ComposeLevel {
+    composeScalar,
+    composeSse,
+    composeAvx2,
+    composeLevelCount
+};
+
+// The fastest kernel this CPU runs, picked once on first use.
+ComposeKernel composeKernel();
+ComposeLevel composeLevel();
+
+// A particular kernel, or NULL if this build or CPU can't run it.
+ComposeKernel composeKernel(ComposeLevel level);
+const char *composeLevelName(ComposeLevel level);
+
+#endif
@@ -0,0 +1,269 @@
+#include "meshlod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+// Fraction of maxPixels the error has to be under before select moves to
+// a coarser level.
+static const float hysteresis = .75f;
+
+// A symmetric 4x4 matrix summing squared distances to planes: for a plane
+// n.p + d = 0 it adds (n, d)(n, d)^T, and v^T Q v, with v = (p, 1), is the
+// sum of the squared distances from p to every plane added.
+struct Quadric {
+    double a[10];
+
+    Quadric() {
+        for(int i = 0; i < 10; i++) {
+            a[i] = 0;
+        }
+    }
+
+    void addPlane(vec3 n, float d) {
+        double p[4] = { n.x, n.y, n.z, d };
+        int k = 0;
+        for(int i = 0; i < 4; i++) {
+            for(int j = i; j < 4; j++) {
+                a[k++] += p[i] * p[j];
+            }
+        }
+    }
+
+    void add(const Quadric &q) {
+        for(int i = 0; i < 10; i++) {
+            a[i] += q.a[i];
+        }
+    }
+
+    double error(vec3 p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x +
+               a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+               a[7] * z * z + 2 * a[8] * z + a[9];
+    }
+};
+
+struct Collapse {
+    double cost;
+    // from moves onto to.
+    GLuint from;
+    GLuint to;
+    // Versions of both ends when it was worked out; stale if either has
+    // changed since.
+    int fromVersion;
+    int toVersion;
+
+    bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+static vec3 faceNormal(const std::vector<vec3> &p, GLuint a, GLuint b, GLuint c) {
+    return glm::cross(p[b] - p[a], p[c] - p[a]);
+}
+
+std::vector<GLuint> simplifyMesh(const std::vector<vec3> &positions, const std::vector<GLuint> &triangles,
+                                 int targetTriangles, float &error) {
+    error = 0;
+    int vertexCount = (int)positions.size();
+    int triangleCount = (int)triangles.size() / 3;
+    std::vector<GLuint> tris(triangles);
+    std::vector<bool> removed(triangleCount, false);
+    std::vector<std::vector<int> > around(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<int> version(vertexCount, 0);
+    std::vector<bool> alive(vertexCount, true);
+
+    for(int t = 0; t < triangleCount; t++) {
+        GLuint a = tris[t * 3], b = tris[t * 3 + 1], c = tris[t * 3 + 2];
+        vec3 n = faceNormal(positions, a, b, c);
+        float length = glm::length(n);
+        if(length > 0) {
+            n /= length;
+            Quadric q;
+            q.addPlane(n, -glm::dot(n, positions[a]));
+            quadrics[a].add(q);
+            quadrics[b].add(q);
+            quadrics[c].add(q);
+        }
+        around[a].push_back(t);
+        around[b].push_back(t);
+        around[c].push_back(t);
+    }
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > queue;
+    // Both ways along every edge of v's triangles.
+    std::function<void(GLuint)> pushEdges = [&](GLuint v) {
+        for(size_t i = 0; i < around[v].size(); i++) {
+            int t = around[v][i];
+            for(int k = 0; k < 3; k++) {
+                GLuint w = tris[t * 3 + k];
+                if(w == v) {
+                    continue;
+                }
+                Quadric q = quadrics[v];
+                q.add(quadrics[w]);
+                Collapse there = { q.error(positions[w]), v, w, version[v], version[w] };
+                Collapse back = { q.error(positions[v]), w, v, version[w], version[v] };
+                queue.push(there);
+                queue.push(back);
+            }
+        }
+    };
+    for(int v = 0; v < vertexCount; v++) {
+        pushEdges((GLuint)v);
+    }
+
+    int remaining = triangleCount;
+    double worst = 0;
+    while(remaining > targetTriangles && !queue.empty()) {
+        Collapse c = queue.top();
+        queue.pop();
+        if(!alive[c.from] || !alive[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion) {
+            continue;
+        }
+
+        // Every triangle that keeps its area mustn't turn over.
+        bool flips = false;
+        for(size_t i = 0; i < around[c.from].size() && !flips; i++) {
+            int t = around[c.from][i];
+            // A collapse elsewhere can leave a dead triangle in the list.
+            if(removed[t]) {
+                continue;
+            }
+            GLuint *v = &tris[t * 3];
+            if(v[0] == c.to || v[1] == c.to || v[2] == c.to) {
+                continue;
+            }
+            vec3 before = faceNormal(positions, v[0], v[1], v[2]);
+            GLuint moved[3] = { v[0], v[1], v[2] };
+            for(int k = 0; k < 3; k++) {
+                if(moved[k] == c.from) {
+                    moved[k] = c.to;
+                }
+            }
+            vec3 after = faceNormal(positions, moved[0], moved[1], moved[2]);
+            if(glm::dot(before, after) <= 0) {
+                flips = true;
+            }
+        }
+        if(flips) {
+            continue;
+        }
+
+        for(size_t i = 0; i < around[c.from].size(); i++) {
+            int t = around[c.from][i];
+            if(removed[t]) {
+                continue;
+            }
+            GLuint *v = &tris[t * 3];
+            if(v[0] == c.to || v[1] == c.to || v[2] == c.to) {
+                removed[t] = true;
+                remaining--;
+                continue;
+            }
+            for(int k = 0; k < 3; k++) {
+                if(v[k] == c.from) {
+                    v[k] = c.to;
+                }
+            }
+            around[c.to].push_back(t);
+        }
+        alive[c.from] = false;
+        around[c.from].clear();
+        std::vector<int> &list = around[c.to];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](int t) { return removed[t]; }), list.end());
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+
+        quadrics[c.to].add(quadrics[c.from]);
+        version[c.to]++;
+        worst = std::max(worst, c.cost);
+        pushEdges(c.to);
+    }
+
+    error = (float)sqrt(std::max(0.0, worst));
+    std::vector<GLuint> out;
+    for(int t = 0; t < triangleCount; t++) {
+        if(!removed[t]) {
+            out.insert(out.end(), &tris[t * 3], &tris[t * 3] + 3);
+        }
+    }
+    return out;
+}
+
+LodMesh::LodMesh() {
+    bound = 0;
+}
+
+void LodMesh::build(ResourceManager &resources, const std::vector<vec3> &positions,
+                    const std::vector<GLuint> &triangles, int maxLevels) {
+    levels.clear();
+    bound = 0;
+    for(size_t i = 0; i < positions.size(); i++) {
+        bound = std::max(bound, glm::length(positions[i]));
+    }
+
+    std::vector<vec3> packedPositions;
+    std::vector<vec3> packedNormals;
+    std::vector<GLuint> packedIndices;
+    std::vector<GLuint> current(triangles);
+    float error = 0;
+    for(int l = 0; l < maxLevels; l++) {
+        // Always from the full mesh, so the error is against that.
+        if(l > 0) {
+            int target = (int)(triangles.size() / 3) >> l;
+            std::vector<GLuint> simpler = simplifyMesh(positions, triangles, target, error);
+            if(simpler.size() >= current.size() || simpler.empty()) {
+                break;
+            }
+            current.swap(simpler);
+        }
+
+        // Only the vertices this level still uses, each with the normal
+        // of the triangles it's left with.
+        std::vector<int> remap(positions.size(), -1);
+        Level level;
+        level.firstIndex = (GLsizei)packedIndices.size();
+        level.indexCount = (GLsizei)current.size();
+        level.baseVertex = (GLint)packedPositions.size();
+        level.error = error;
+        for(size_t i = 0; i < current.size(); i++) {
+            GLuint v = current[i];
+            if(remap[v] < 0) {
+                remap[v] = (int)packedPositions.size() - level.baseVertex;
+                packedPositions.push_back(positions[v]);
+                packedNormals.push_back(vec3(0));
+            }
+            packedIndices.push_back((GLuint)remap[v]);
+        }
+        for(size_t i = 0; i < current.size(); i += 3) {
+            vec3 n = faceNormal(positions, current[i], current[i + 1], current[i + 2]);
+            for(int k = 0; k < 3; k++) {
+                packedNormals[level.baseVertex + remap[current[i + k]]] += n;
+            }
+        }
+        for(size_t i = level.baseVertex; i < packedNormals.size(); i++) {
+            float length = glm::length(packedNormals[i]);
+            packedNormals[i] = length > 0 ? packedNormals[i] / length : vec3(0, 1, 0);
+        }
+        levels.push_back(level);
+    }
+
+    mesh = resources.mesh(&packedPositions[0], &packedNormals[0], (int)packedPositions.size(),
+                          &packedIndices[0], (int)packedIndices.size());
+}
+
+int LodMesh::select(float distance, float scale, float pixelsPerUnit, float maxPixels, int current) const {
+    float perUnit = scale * pixelsPerUnit / std::max(distance, 1e-3f);
+    int best = 0;
+    for(int l = (int)levels.size() - 1; l > 0; l--) {
+        float pixels = levels[l].error * perUnit;
+        float limit = l > current ? maxPixels * hysteresis : maxPixels;
+        if(pixels <= limit) {
+            best = l;
+            break;
+        }
+    }
+    return best;
+}
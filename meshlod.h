@@ -0,0 +1,71 @@
+#ifndef __MESHLOD__INCLUDE__
+#define __MESHLOD__INCLUDE__
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "resourcemanager.h"
+
+using glm::vec3;
+
+// Simplifies a closed triangle mesh (a list of triangles indexing
+// positions, no two positions the same) by quadric edge collapse, down
+// to at most targetTriangles. Every collapse moves one end of an edge
+// onto the other, whichever moves the surface least going by the sum of
+// the squared distances to the planes of the triangles either end
+// touched; collapses that would flip a triangle over are skipped.
+// Returns the surviving triangles and sets error to the square root of
+// the worst collapse's quadric cost: the summed squared distances to
+// every plane its vertex had piled up, so a conservative bound, in the
+// mesh's units, on how far the surface moved rather than the distance
+// itself.
+std::vector<GLuint> simplifyMesh(const std::vector<vec3> &positions, const std::vector<GLuint> &triangles,
+                                 int targetTriangles, float &error);
+
+// One mesh at several levels of detail, every level packed into the same
+// vertex and index buffers so switching between them is only a matter of
+// which index range is drawn: no VAO or buffer changes at all.
+//
+// Levels are made at startup with simplifyMesh, each from the full mesh
+// with about half the triangles of the last. Each is drawn as
+// GL_TRIANGLES with its own vertices, smooth normals worked out for that
+// level, from firstIndex with baseVertex added to every index.
+class LodMesh {
+    public:
+        struct Level {
+            GLsizei firstIndex;
+            GLsizei indexCount;
+            GLint baseVertex;
+            // Bound on how far this level strays from the full mesh, in
+            // the mesh's units, from simplifyMesh; 0 for level 0.
+            float error;
+        };
+
+        LodMesh();
+
+        // Makes up to maxLevels levels, stopping early once a level
+        // can't get any simpler, and uploads them.
+        void build(ResourceManager &resources, const std::vector<vec3> &positions,
+                   const std::vector<GLuint> &triangles, int maxLevels);
+
+        // The coarsest level whose error, scale times bigger and distance
+        // away, comes to no more than maxPixels on screen; pixelsPerUnit
+        // is the screen's pixels per world unit at a distance of 1.
+        // Moving to a coarser level than current takes the error being
+        // under a fraction of maxPixels, so an object right on the line
+        // doesn't flick between two levels.
+        int select(float distance, float scale, float pixelsPerUnit, float maxPixels, int current) const;
+
+        GLuint vertexArray() const { return mesh.vao; }
+        int levelCount() const { return (int)levels.size(); }
+        const Level &level(int i) const { return levels[i]; }
+        // Of every vertex, from the origin.
+        float radius() const { return bound; }
+
+    private:
+        Mesh mesh;
+        std::vector<Level> levels;
+        float bound;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#version 330
+
+in vec4 fcolor;
+out vec4 color_out;
+
+// Round, and softer towards the edge.
+void main(){
+        vec2 d = gl_PointCoord * 2 - 1;
+        float r2 = dot(d, d);
+        if(r2 > 1) {
+                discard;
+        }
+        color_out = fcolor * (1 - r2);
+}
@@ -0,0 +1,76 @@
+#version 330
+
+// One step of the particles, captured with transform feedback; see
+// particles.h. Has to match ParticleSystem::move and spawn.
+
+uniform float dt;
+// Steps taken so far, so each birth lands somewhere new.
+uniform uint generation;
+// Index one past the last firefly, mist and leaf particle.
+uniform int kindEnd[3];
+// Per kind: sway, sway rate, lift and drag.
+uniform vec4 motion[3];
+// Per kind: shortest and longest life, how fast it's born moving, and 1
+// if it dies when it sinks below floorY.
+uniform vec4 birth[3];
+// Where things are born: the meadow, the lake, then the tree tops.
+uniform vec4 boxMin[18];
+uniform vec4 boxMax[18];
+uniform int treeCount;
+uniform float floorY;
+
+// Position and age, velocity and lifetime.
+in vec4 position;
+in vec4 velocity;
+out vec4 outPosition;
+out vec4 outVelocity;
+
+uint hash(uint v) {
+  uint state = v * 747796405u + 2891336453u;
+  uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+// 0 to 1 from the top 24 bits.
+float unit(uint h) {
+  return float(h >> 8u) * (1.0 / 16777216.0);
+}
+
+void main(){
+  int i = gl_VertexID;
+  int kind = i < kindEnd[0] ? 0 : (i < kindEnd[1] ? 1 : 2);
+  vec4 m = motion[kind];
+
+  float age = position.w + dt;
+  float life = velocity.w;
+  float phase = age * m.y + unit(hash(uint(i))) * 6.2831853;
+  vec3 v = velocity.xyz + vec3(sin(phase) * m.x, m.z, cos(phase) * m.x) * dt;
+  v *= max(0.0, 1.0 - m.w * dt);
+  vec3 p = position.xyz + v * dt;
+
+  if(age > life || (p.y < floorY && birth[kind].w > 0)) {
+    uint h = hash(uint(i) ^ hash(generation));
+    int box = kind;
+    if(kind == 2) {
+      box = treeCount > 0 ? 2 + int(h % uint(treeCount)) : 0;
+    }
+    h = hash(h);
+    p.x = mix(boxMin[box].x, boxMax[box].x, unit(h));
+    h = hash(h);
+    p.y = mix(boxMin[box].y, boxMax[box].y, unit(h));
+    h = hash(h);
+    p.z = mix(boxMin[box].z, boxMax[box].z, unit(h));
+    h = hash(h);
+    life = mix(birth[kind].x, birth[kind].y, unit(h));
+    h = hash(h);
+    v.x = (unit(h) - .5) * birth[kind].z;
+    h = hash(h);
+    v.y = (unit(h) - .5) * birth[kind].z;
+    h = hash(h);
+    v.z = (unit(h) - .5) * birth[kind].z;
+    age = 0;
+  }
+
+  outPosition = vec4(p, age);
+  outVelocity = vec4(v, life);
+}
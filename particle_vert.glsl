@@ -0,0 +1,36 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+uniform int kindEnd[3];
+// Per kind: colour, and how opaque it is; 0 for ones that glow, which
+// are added to what's behind them.
+uniform vec4 kindColor[3];
+// Per kind, in world units across.
+uniform float kindSize[3];
+uniform float viewportHeight;
+
+// Position and age, velocity and lifetime.
+in vec4 position;
+in vec4 velocity;
+// Premultiplied.
+out vec4 fcolor;
+
+void main(){
+  int kind = gl_VertexID < kindEnd[0] ? 0 : (gl_VertexID < kindEnd[1] ? 1 : 2);
+  gl_Position = projection * view * vec4(position.xyz, 1);
+
+  // Fade in over the first second and out over the last.
+  float fade = clamp(position.w, 0, 1) * clamp(velocity.w - position.w, 0, 1);
+  if(kind == 0) {
+    fade *= .5 + .5 * sin(position.w * 6 + float(gl_VertexID));
+  }
+  vec4 c = kindColor[kind];
+  fcolor = vec4(c.a > 0 ? c.rgb * c.a : c.rgb, c.a) * fade;
+
+  gl_PointSize = max(1.0, kindSize[kind] * projection[1][1] * viewportHeight * .5 / gl_Position.w);
+}
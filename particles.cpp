@@ -0,0 +1,403 @@
+#include "particles.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define PARTICLES_SSE
+#endif
+
+// How each kind moves, all in world units and seconds. Every particle
+// sways along a circle at its own phase, rises (or falls) at lift and is
+// slowed by drag.
+struct KindParams {
+    // Of the particle count.
+    float share;
+    float minLife;
+    float maxLife;
+    float sway;
+    // Radians per second.
+    float swayRate;
+    float lift;
+    float drag;
+    // Speed it's born with, at most half this along each axis.
+    float spread;
+    // Dies when it sinks below the meadow. The lake may be lower.
+    bool grounded;
+    // Alpha 0 for ones that glow.
+    vec4 color;
+    float size;
+};
+
+static const KindParams kinds[ParticleSystem::kindCount] = {
+    // fireflies wander about
+    { .4f, 3, 7, .8f, 1.7f, 0, 1.5f, .4f, true, vec4(1, .85f, .3f, 0), .03f },
+    // mist hardly moves, and is mostly see through
+    { .4f, 8, 14, .05f, .3f, .005f, .5f, .05f, false, vec4(.55f, .6f, .65f, .06f), .5f },
+    // leaves flutter down
+    { .2f, 6, 10, .6f, 2.5f, -.6f, 2, .2f, true, vec4(.35f, .45f, .15f, 1), .04f },
+};
+
+// Never step further than this in one go, or drag would stop everything.
+static const float maxStep = .1f;
+
+static const float twoPi = 6.2831853f;
+
+// The same hash as particle_update_vert.glsl, so both paths are born in
+// the same places.
+static uint32_t hash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// 0 to 1 from the top 24 bits.
+static float unit(uint32_t h) {
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+static float mix(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+#ifdef PARTICLES_SSE
+
+// sin to within about .001, which is plenty for swaying: x is wrapped
+// into -pi..pi, then a parabola through the zeros and peaks, squared up
+// a little towards the real curve.
+static __m128 sin4(__m128 x) {
+    const __m128 invTwoPi = _mm_set1_ps(1 / twoPi);
+    x = _mm_sub_ps(x, _mm_mul_ps(_mm_set1_ps(twoPi),
+                                 _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, invTwoPi)))));
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.27323954f), x),
+                          _mm_mul_ps(_mm_set1_ps(-.405284735f), _mm_mul_ps(x, _mm_and_ps(x, absMask))));
+    return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(.225f),
+                                 _mm_sub_ps(_mm_mul_ps(y, _mm_and_ps(y, absMask)), y)), y);
+}
+
+#endif
+
+ParticleSystem::ParticleSystem() {
+    count = 0;
+    cpu = false;
+    generation = 0;
+    emitting = false;
+    treeCount = 0;
+    floorY = 0;
+    current = 0;
+    for(int k = 0; k < kindCount; k++) {
+        kindEnd[k] = 0;
+    }
+}
+
+void ParticleSystem::initialize(ResourceManager &resources, int n, bool onCpu) {
+    initializeOpenGLFunctions();
+    count = std::max(0, n);
+    cpu = onCpu;
+
+    float share = 0;
+    for(int k = 0; k < kindCount; k++) {
+        share += kinds[k].share;
+        kindEnd[k] = k == kindCount - 1 ? count : (int)(count * share);
+    }
+
+    static const char *const varyings[] = { "outPosition", "outVelocity" };
+    updateProg = resources.program(":/particle_update_vert.glsl", ":/shadow_frag.glsl", varyings, 2);
+    drawProg = resources.program(":/particle_vert.glsl", ":/particle_frag.glsl");
+
+    vec4 motion[kindCount];
+    vec4 birth[kindCount];
+    vec4 color[kindCount];
+    float size[kindCount];
+    for(int k = 0; k < kindCount; k++) {
+        motion[k] = vec4(kinds[k].sway, kinds[k].swayRate, kinds[k].lift, kinds[k].drag);
+        birth[k] = vec4(kinds[k].minLife, kinds[k].maxLife, kinds[k].spread, kinds[k].grounded);
+        color[k] = kinds[k].color;
+        size[k] = kinds[k].size;
+    }
+
+    glUseProgram(updateProg);
+    glUniform1iv(glGetUniformLocation(updateProg, "kindEnd"), kindCount, kindEnd);
+    glUniform4fv(glGetUniformLocation(updateProg, "motion"), kindCount, &motion[0].x);
+    glUniform4fv(glGetUniformLocation(updateProg, "birth"), kindCount, &birth[0].x);
+    dtLoc = glGetUniformLocation(updateProg, "dt");
+    generationLoc = glGetUniformLocation(updateProg, "generation");
+
+    glUseProgram(drawProg);
+    glUniform1iv(glGetUniformLocation(drawProg, "kindEnd"), kindCount, kindEnd);
+    glUniform4fv(glGetUniformLocation(drawProg, "kindColor"), kindCount, &color[0].x);
+    glUniform1fv(glGetUniformLocation(drawProg, "kindSize"), kindCount, size);
+    viewportLoc = glGetUniformLocation(drawProg, "viewportHeight");
+    glUseProgram(0);
+
+    // Position and age, then velocity and lifetime.
+    GLsizei stride = 8 * sizeof(float);
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(2, vaos);
+    for(int b = 0; b < 2; b++) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[b]);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)count * stride, NULL,
+                     cpu ? GL_STREAM_DRAW : GL_DYNAMIC_COPY);
+        glBindVertexArray(vaos[b]);
+        glEnableVertexAttribArray(positionAttrib);
+        glVertexAttribPointer(positionAttrib, 4, GL_FLOAT, GL_FALSE, stride, 0);
+        glEnableVertexAttribArray(velocityAttrib);
+        glVertexAttribPointer(velocityAttrib, 4, GL_FLOAT, GL_FALSE, stride,
+                              (const void *)(4 * sizeof(float)));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::setEmitters(const Aabb &meadow, const Aabb &lake, const std::vector<Aabb> &treeTops) {
+    // Fireflies up to a couple of sheep heights over the grass, mist in a
+    // thin layer on the water.
+    boxMin[firefly] = vec4(meadow.min.x, meadow.max.y + .1f, meadow.min.z, 0);
+    boxMax[firefly] = vec4(meadow.max.x, meadow.max.y + 1.5f, meadow.max.z, 0);
+    boxMin[mist] = vec4(lake.min.x, lake.max.y, lake.min.z, 0);
+    boxMax[mist] = vec4(lake.max.x, lake.max.y + .3f, lake.max.z, 0);
+    treeCount = std::min((int)treeTops.size(), maxTrees);
+    for(int i = 0; i < treeCount; i++) {
+        boxMin[2 + i] = vec4(treeTops[i].min, 0);
+        boxMax[2 + i] = vec4(treeTops[i].max, 0);
+    }
+    for(int i = 2 + treeCount; i < maxBoxes; i++) {
+        boxMin[i] = boxMin[firefly];
+        boxMax[i] = boxMax[firefly];
+    }
+    floorY = meadow.max.y;
+    emitting = true;
+
+    glUseProgram(updateProg);
+    glUniform4fv(glGetUniformLocation(updateProg, "boxMin"), maxBoxes, &boxMin[0].x);
+    glUniform4fv(glGetUniformLocation(updateProg, "boxMax"), maxBoxes, &boxMax[0].x);
+    glUniform1i(glGetUniformLocation(updateProg, "treeCount"), treeCount);
+    glUniform1f(glGetUniformLocation(updateProg, "floorY"), floorY);
+    glUseProgram(0);
+
+    // Everything is born at once, but some way into its life so they
+    // don't all die together either.
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    age.resize(count);
+    vx.resize(count);
+    vy.resize(count);
+    vz.resize(count);
+    life.resize(count);
+    seeds.resize(count);
+    JobSystem::instance().parallelFor(count, 8192, [this](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            spawn(i, generation);
+            age[i] = unit(hash(hash(i))) * life[i];
+            seeds[i] = unit(hash(i)) * twoPi;
+        }
+    });
+    uploadCpu();
+
+    // From here on the GPU path keeps everything in the buffers.
+    if(!cpu) {
+        std::vector<float>().swap(x);
+        std::vector<float>().swap(y);
+        std::vector<float>().swap(z);
+        std::vector<float>().swap(age);
+        std::vector<float>().swap(vx);
+        std::vector<float>().swap(vy);
+        std::vector<float>().swap(vz);
+        std::vector<float>().swap(life);
+        std::vector<float>().swap(seeds);
+    }
+}
+
+void ParticleSystem::spawn(int i, unsigned int salt) {
+    int kind = i < kindEnd[firefly] ? firefly : (i < kindEnd[mist] ? mist : leaf);
+    const KindParams &params = kinds[kind];
+
+    uint32_t h = hash(i ^ hash(salt));
+    int box = kind;
+    if(kind == leaf) {
+        box = treeCount > 0 ? 2 + (int)(h % treeCount) : firefly;
+    }
+    h = hash(h);
+    x[i] = mix(boxMin[box].x, boxMax[box].x, unit(h));
+    h = hash(h);
+    y[i] = mix(boxMin[box].y, boxMax[box].y, unit(h));
+    h = hash(h);
+    z[i] = mix(boxMin[box].z, boxMax[box].z, unit(h));
+    h = hash(h);
+    life[i] = mix(params.minLife, params.maxLife, unit(h));
+    h = hash(h);
+    vx[i] = (unit(h) - .5f) * params.spread;
+    h = hash(h);
+    vy[i] = (unit(h) - .5f) * params.spread;
+    h = hash(h);
+    vz[i] = (unit(h) - .5f) * params.spread;
+    age[i] = 0;
+}
+
+void ParticleSystem::move(int kind, int begin, int end, float dt) {
+    const KindParams &params = kinds[kind];
+    float damp = std::max(0.0f, 1 - params.drag * dt);
+    float ground = params.grounded ? floorY : -FLT_MAX;
+    auto step = [&](int i) {
+        float phase = (age[i] + dt) * params.swayRate + seeds[i];
+        age[i] += dt;
+        vx[i] = (vx[i] + sinf(phase) * params.sway * dt) * damp;
+        vy[i] = (vy[i] + params.lift * dt) * damp;
+        vz[i] = (vz[i] + cosf(phase) * params.sway * dt) * damp;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+        if(age[i] > life[i] || y[i] < ground) {
+            spawn(i, generation);
+        }
+    };
+    int i = begin;
+
+#ifdef PARTICLES_SSE
+    // One at a time up to a multiple of four, where the vectors' 16 byte
+    // alignment lines up.
+    for(; i < end && (i & 3); i++) {
+        step(i);
+    }
+
+    __m128 dt4 = _mm_set1_ps(dt);
+    __m128 damp4 = _mm_set1_ps(damp);
+    __m128 rate = _mm_set1_ps(params.swayRate);
+    __m128 swayStep = _mm_set1_ps(params.sway * dt);
+    __m128 liftStep = _mm_set1_ps(params.lift * dt);
+    __m128 quarter = _mm_set1_ps(twoPi / 4);
+    __m128 floor4 = _mm_set1_ps(ground);
+    for(; i + 4 <= end; i += 4) {
+        __m128 a = _mm_add_ps(_mm_load_ps(&age[i]), dt4);
+        __m128 phase = _mm_add_ps(_mm_mul_ps(a, rate), _mm_load_ps(&seeds[i]));
+        __m128 s = sin4(phase);
+        __m128 c = sin4(_mm_add_ps(phase, quarter));
+
+        __m128 velX = _mm_mul_ps(_mm_add_ps(_mm_load_ps(&vx[i]), _mm_mul_ps(s, swayStep)), damp4);
+        __m128 velY = _mm_mul_ps(_mm_add_ps(_mm_load_ps(&vy[i]), liftStep), damp4);
+        __m128 velZ = _mm_mul_ps(_mm_add_ps(_mm_load_ps(&vz[i]), _mm_mul_ps(c, swayStep)), damp4);
+        __m128 posY = _mm_add_ps(_mm_load_ps(&y[i]), _mm_mul_ps(velY, dt4));
+        _mm_store_ps(&x[i], _mm_add_ps(_mm_load_ps(&x[i]), _mm_mul_ps(velX, dt4)));
+        _mm_store_ps(&y[i], posY);
+        _mm_store_ps(&z[i], _mm_add_ps(_mm_load_ps(&z[i]), _mm_mul_ps(velZ, dt4)));
+        _mm_store_ps(&vx[i], velX);
+        _mm_store_ps(&vy[i], velY);
+        _mm_store_ps(&vz[i], velZ);
+        _mm_store_ps(&age[i], a);
+
+        // Few die in any one step, so they're born again one at a time.
+        int dead = _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(a, _mm_load_ps(&life[i])),
+                                             _mm_cmplt_ps(posY, floor4)));
+        while(dead) {
+            int lane = 0;
+            while(!(dead & (1 << lane))) {
+                lane++;
+            }
+            spawn(i + lane, generation);
+            dead &= ~(1 << lane);
+        }
+    }
+#endif
+
+    for(; i < end; i++) {
+        step(i);
+    }
+}
+
+void ParticleSystem::updateCpu(float dt) {
+    JobSystem::instance().parallelFor(count, 8192, [this, dt](int begin, int end) {
+        // A chunk can straddle where one kind ends and the next starts.
+        int start = 0;
+        for(int k = 0; k < kindCount; k++) {
+            int from = std::max(begin, start);
+            int to = std::min(end, kindEnd[k]);
+            if(from < to) {
+                move(k, from, to, dt);
+            }
+            start = kindEnd[k];
+        }
+    });
+    uploadCpu();
+}
+
+void ParticleSystem::uploadCpu() {
+    GLsizeiptr bytes = (GLsizeiptr)count * 8 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[current]);
+    // Orphaned, so this doesn't wait on last frame's draw.
+    glBufferData(GL_ARRAY_BUFFER, bytes, NULL, cpu ? GL_STREAM_DRAW : GL_DYNAMIC_COPY);
+    float *out = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(out) {
+        JobSystem::instance().parallelFor(count, 8192, [&](int begin, int end) {
+            for(int i = begin; i < end; i++) {
+                float *p = out + (size_t)i * 8;
+                p[0] = x[i];
+                p[1] = y[i];
+                p[2] = z[i];
+                p[3] = age[i];
+                p[4] = vx[i];
+                p[5] = vy[i];
+                p[6] = vz[i];
+                p[7] = life[i];
+            }
+        });
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::update(float dt) {
+    if(!emitting || count == 0 || dt <= 0) {
+        return;
+    }
+    dt = std::min(dt, maxStep);
+    generation++;
+
+    if(cpu) {
+        updateCpu(dt);
+        return;
+    }
+
+    glUseProgram(updateProg);
+    glUniform1f(dtLoc, dt);
+    glUniform1ui(generationLoc, generation);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(vaos[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, count);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    current = 1 - current;
+}
+
+void ParticleSystem::render(int viewportHeight) {
+    if(!emitting || count == 0) {
+        return;
+    }
+
+    // Premultiplied, so the glowing ones (alpha 0) add and the rest blend.
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    glUseProgram(drawProg);
+    glUniform1f(viewportLoc, (float)viewportHeight);
+    glBindVertexArray(vaos[current]);
+    glDrawArrays(GL_POINTS, 0, count);
+    glBindVertexArray(0);
+
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
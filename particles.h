@@ -0,0 +1,101 @@
+#ifndef __PARTICLES__INCLUDE__
+#define __PARTICLES__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.h"
+#include "resourcemanager.h"
+
+using glm::vec3;
+using glm::vec4;
+
+// Fireflies over the meadow, mist over the lake and leaves falling from
+// the trees.
+//
+// A particle is a position and age and a velocity and lifetime, two vec4s.
+// When it's older than its lifetime (or a leaf reaches the ground) it's
+// born again somewhere in its emitter, picked by hashing its index and
+// the time, so nothing ever has to be told about a single particle and
+// nothing is read back.
+//
+// On the GPU a step is one pass of particle_update_vert.glsl with the
+// rasterizer off, reading one of a pair of buffers and writing the other
+// through transform feedback. The CPU path does the same step over
+// structure of arrays, four particles at a time with SSE and spread over
+// the job system, and uploads the result into the same buffer, for
+// comparison. Either way the particles are drawn straight from the buffer
+// as point sprites.
+class ParticleSystem : protected QOpenGLFunctions_3_3_Core {
+    public:
+        enum Kind {
+            firefly,
+            mist,
+            leaf,
+            kindCount
+        };
+
+        ParticleSystem();
+
+        // Needs the GL context to be current. count is split between the
+        // kinds in fixed shares.
+        void initialize(ResourceManager &resources, int count, bool cpu);
+
+        // Where each kind is born: fireflies just above the meadow, mist
+        // just above the lake, leaves in any of the tree tops. Leaves die
+        // when they fall below the meadow. Every particle is born again
+        // here, some way through its life. Needs the GL context too.
+        void setEmitters(const Aabb &meadow, const Aabb &lake, const std::vector<Aabb> &treeTops);
+
+        // Moves every particle on by dt seconds.
+        void update(float dt);
+        // Draws them, with the Camera block bound, blended over whatever
+        // has been drawn so far without writing depth.
+        void render(int viewportHeight);
+
+        int size() const { return count; }
+        bool onCpu() const { return cpu; }
+
+    private:
+        static const int maxTrees = 16;
+        // The meadow and the lake, then the tree tops.
+        static const int maxBoxes = 2 + maxTrees;
+
+        void spawn(int i, unsigned int salt);
+        void move(int kind, int begin, int end, float dt);
+        void updateCpu(float dt);
+        void uploadCpu();
+
+        int count;
+        bool cpu;
+        // Index one past the last particle of each kind.
+        int kindEnd[kindCount];
+        // Steps taken, which salts the births.
+        unsigned int generation;
+        // Nothing is born until there's somewhere to be born.
+        bool emitting;
+
+        vec4 boxMin[maxBoxes];
+        vec4 boxMax[maxBoxes];
+        int treeCount;
+        float floorY;
+
+        GLuint updateProg;
+        GLuint drawProg;
+        GLint dtLoc;
+        GLint generationLoc;
+        GLint viewportLoc;
+        // Ping-pong pair; current is the one last written. Updating and
+        // drawing read a buffer the same way, so each has one VAO.
+        GLuint buffers[2];
+        GLuint vaos[2];
+        int current;
+
+        // The CPU path's copy, structure of arrays.
+        std::vector<float> x, y, z, age;
+        std::vector<float> vx, vy, vz, life;
+        std::vector<float> seeds;
+};
+
+#endif
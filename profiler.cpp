@@ -0,0 +1,210 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// Weight of the newest sample in the smoothed times shown on screen.
+static const double smoothing = .1;
+
+Profiler::Profiler() {
+    initialized = false;
+    current = NULL;
+    frameIndex = 0;
+    gpuOpen = false;
+    dropped = 0;
+    gpuTotalMs = 0;
+    recordFrames = false;
+
+    for(int i = 0; i < frameSlots; i++) {
+        ring[i].frame = -1;
+        ring[i].cpuStartNs = 0;
+        ring[i].used = 0;
+        ring[i].pending = false;
+    }
+
+    clock.start();
+}
+
+void Profiler::initialize() {
+    initializeOpenGLFunctions();
+    initialized = true;
+}
+
+void Profiler::beginFrame() {
+    FrameSlot &slot = ring[frameIndex % frameSlots];
+
+    // This slot's queries were issued frameSlots frames ago. Either they
+    // are done by now or the frame gets dropped.
+    if(slot.pending && !resolve(slot, false)) {
+        dropped++;
+    }
+
+    slot.frame = frameIndex;
+    slot.cpuStartNs = clock.nsecsElapsed();
+    slot.used = 0;
+    slot.pending = false;
+    current = &slot;
+}
+
+void Profiler::endFrame() {
+    if(gpuOpen) {
+        endGpu();
+    }
+    if(current) {
+        current->pending = current->used > 0;
+        current = NULL;
+    }
+    if(recordFrames) {
+        frameGpu.resize(frameIndex + 1, -1);
+    }
+    frameIndex++;
+}
+
+void Profiler::beginGpu(const char *name) {
+    if(!initialized || !current || gpuOpen) {
+        return;
+    }
+
+    FrameSlot &slot = *current;
+    if(slot.used == slot.samples.size()) {
+        GpuSample sample;
+        glGenQueries(1, &sample.query);
+        slot.samples.push_back(sample);
+    }
+    GpuSample &sample = slot.samples[slot.used++];
+    sample.name = name;
+
+    glBeginQuery(GL_TIME_ELAPSED, sample.query);
+    gpuOpen = true;
+}
+
+void Profiler::endGpu() {
+    if(!gpuOpen) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuOpen = false;
+}
+
+void Profiler::beginCpu(const char *name) {
+    OpenCpuScope scope;
+    scope.name = name;
+    scope.startNs = clock.nsecsElapsed();
+    cpuStack.push_back(scope);
+}
+
+void Profiler::endCpu() {
+    if(cpuStack.empty()) {
+        return;
+    }
+    OpenCpuScope scope = cpuStack.back();
+    cpuStack.pop_back();
+    addSample(scope.name, false, scope.startNs, clock.nsecsElapsed() - scope.startNs);
+}
+
+void Profiler::flush() {
+    // Resolve oldest first so the events stay in order.
+    for(int i = 0; i < frameSlots; i++) {
+        FrameSlot &slot = ring[(frameIndex + i) % frameSlots];
+        if(slot.pending) {
+            resolve(slot, true);
+        }
+    }
+}
+
+bool Profiler::resolve(FrameSlot &slot, bool wait) {
+    if(!wait) {
+        // Queries finish in order, so if the last one is in they all are.
+        GLuint available = 0;
+        glGetQueryObjectuiv(slot.samples[slot.used - 1].query,
+                            GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            slot.pending = false;
+            return false;
+        }
+    }
+
+    // There's no GPU clock to line the passes up against, so they are
+    // laid out back to back from when the frame started on the CPU.
+    int64_t start = slot.cpuStartNs;
+    int64_t total = 0;
+    for(size_t i = 0; i < slot.used; i++) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(slot.samples[i].query, GL_QUERY_RESULT, &elapsed);
+        addSample(slot.samples[i].name, true, start, (int64_t)elapsed);
+        start += elapsed;
+        total += elapsed;
+    }
+
+    double ms = total / 1000000.0;
+    gpuTotalMs += (ms - gpuTotalMs) * smoothing;
+    if(recordFrames && slot.frame < (int)frameGpu.size()) {
+        frameGpu[slot.frame] = ms;
+    }
+
+    slot.pending = false;
+    return true;
+}
+
+void Profiler::addSample(const char *name, bool gpu, int64_t startNs, int64_t durationNs) {
+    double ms = durationNs / 1000000.0;
+
+    std::vector<Scope>::iterator it = scopeList.begin();
+    for(; it != scopeList.end(); ++it) {
+        if(it->gpu == gpu && std::string(it->name) == name) {
+            break;
+        }
+    }
+    if(it == scopeList.end()) {
+        Scope scope;
+        scope.name = name;
+        scope.gpu = gpu;
+        scope.ms = ms;
+        scopeList.push_back(scope);
+    } else {
+        it->ms += (ms - it->ms) * smoothing;
+    }
+
+    Event event;
+    event.name = name;
+    event.gpu = gpu;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    events.push_back(event);
+    if(events.size() > maxEvents) {
+        events.pop_front();
+    }
+}
+
+double Profiler::recordedGpuMs(int frame) const {
+    if(frame < 0 || frame >= (int)frameGpu.size()) {
+        return -1;
+    }
+    return frameGpu[frame];
+}
+
+bool Profiler::writeChromeTrace(const QString &path) const {
+    std::ofstream out(path.toStdString().c_str());
+    if(!out) {
+        std::cerr << "Could not write " << path.toStdString() << std::endl;
+        return false;
+    }
+
+    // Complete ("X") events in microseconds, CPU scopes on one track and
+    // GPU passes on another.
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\": [\n";
+    out << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, "
+           "\"args\": {\"name\": \"CPU\"}},\n";
+    out << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 1, "
+           "\"args\": {\"name\": \"GPU\"}}";
+    for(std::deque<Event>::const_iterator it = events.begin(); it != events.end(); ++it) {
+        out << ",\n  {\"name\": \"" << it->name << "\", \"ph\": \"X\", \"pid\": 0, "
+            << "\"tid\": " << (it->gpu ? 1 : 0) << ", "
+            << "\"ts\": " << it->startNs / 1000.0 << ", "
+            << "\"dur\": " << it->durationNs / 1000.0 << "}";
+    }
+    out << "\n]}\n";
+    return true;
+}
@@ -0,0 +1,119 @@
+#ifndef __PROFILER__INCLUDE__
+#define __PROFILER__INCLUDE__
+
+#include <QElapsedTimer>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Named CPU and GPU timing scopes.
+//
+// GPU scopes are GL_TIME_ELAPSED queries. Each frame's queries live in
+// one of frameSlots slots and are only read back when that slot comes
+// around again, a few frames later. If the results still aren't in by
+// then the frame is dropped rather than waited for, so profiling never
+// stalls the pipeline. GL_TIME_ELAPSED can't nest, so GPU scopes can't
+// either; CPU scopes can.
+//
+// Scope names are expected to be string literals.
+class Profiler : protected QOpenGLFunctions_3_3_Core {
+    public:
+        struct Scope {
+            const char *name;
+            bool gpu;
+            // Exponentially smoothed, for display.
+            double ms;
+        };
+
+        Profiler();
+
+        // Needs the GL context to be current.
+        void initialize();
+
+        void beginFrame();
+        void endFrame();
+
+        void beginGpu(const char *name);
+        void endGpu();
+        void beginCpu(const char *name);
+        void endCpu();
+
+        // Waits for every outstanding query. Only meant for the end of a
+        // benchmark run, it stalls.
+        void flush();
+
+        const std::vector<Scope> &scopes() const { return scopeList; }
+        // Smoothed GPU time of the whole frame.
+        double gpuFrameMs() const { return gpuTotalMs; }
+        int droppedFrames() const { return dropped; }
+
+        // When on, the GPU time of every frame is kept so it can be looked
+        // up by frame number afterwards. Off by default, it grows forever.
+        void setRecordFrames(bool enabled) { recordFrames = enabled; }
+        // -1 until the frame's queries are read back, or if it was dropped.
+        double recordedGpuMs(int frame) const;
+
+        // Writes the recorded scopes in the Chrome trace event format,
+        // for chrome://tracing or https://ui.perfetto.dev.
+        bool writeChromeTrace(const QString &path) const;
+
+    private:
+        static const int frameSlots = 4;
+        // Oldest events are thrown away past this, about a minute of
+        // frames.
+        static const size_t maxEvents = 50000;
+
+        struct GpuSample {
+            const char *name;
+            GLuint query;
+        };
+
+        struct FrameSlot {
+            int frame;
+            int64_t cpuStartNs;
+            // Queries are created as needed and reused from then on, used
+            // says how many this frame has.
+            std::vector<GpuSample> samples;
+            size_t used;
+            bool pending;
+        };
+
+        struct OpenCpuScope {
+            const char *name;
+            int64_t startNs;
+        };
+
+        struct Event {
+            const char *name;
+            bool gpu;
+            int64_t startNs;
+            int64_t durationNs;
+        };
+
+        bool resolve(FrameSlot &slot, bool wait);
+        void addSample(const char *name, bool gpu, int64_t startNs, int64_t durationNs);
+
+        bool initialized;
+        QElapsedTimer clock;
+
+        FrameSlot ring[frameSlots];
+        FrameSlot *current;
+        int frameIndex;
+        bool gpuOpen;
+        int dropped;
+
+        std::vector<OpenCpuScope> cpuStack;
+
+        std::vector<Scope> scopeList;
+        double gpuTotalMs;
+
+        std::deque<Event> events;
+
+        bool recordFrames;
+        std::vector<double> frameGpu;
+};
+
+#endif
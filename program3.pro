@@ -1,5 +1,5 @@
-HEADERS += glwidget.h 
-SOURCES += glwidget.cpp main.cpp
+HEADERS += glwidget.h renderer.h renderqueue.h resourcemanager.h benchmark.h profiler.h simclock.h cameracontroller.h inputring.h renderwindow.h bounds.h bvh.h scene.h hierarchy.h matrixbatch.h jobsystem.h flock.h particles.h chunkstreamer.h heightfield.h terrain.h grass.h impostors.h meshlod.h
+SOURCES += glwidget.cpp renderer.cpp renderqueue.cpp resourcemanager.cpp benchmark.cpp profiler.cpp simclock.cpp cameracontroller.cpp renderwindow.cpp bounds.cpp bvh.cpp scene.cpp hierarchy.cpp matrixbatch.cpp jobsystem.cpp flock.cpp particles.cpp chunkstreamer.cpp heightfield.cpp terrain.cpp grass.cpp impostors.cpp meshlod.cpp main.cpp
 
 QT += opengl designer
 CONFIG -= app_bundle
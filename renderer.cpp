@@ -0,0 +1,1704 @@
+#include "renderer.h"
+#include "jobsystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <QElapsedTimer>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using glm::perspective;
+using glm::value_ptr;
+
+static int defaultCascades = 3;
+static int defaultShadowSize = 1024;
+static int defaultParticles = 200000;
+static bool defaultCpuParticles = false;
+
+// Chunks are wanted as far out as the far plane, and there are slots
+// for about as many as that takes.
+static const int chunkSlots = 128;
+
+// Rocks on the meadow, and how many pixels out a rock's level of detail
+// may be before a finer one is drawn.
+static const int rockCount = 48;
+static const int rockLevels = 5;
+static const float rockPixels = 1.0f;
+
+// The heightfield repeats every 256 units, half a unit between samples.
+static const int heightfieldSize = 512;
+static const float heightfieldSpacing = .5f;
+
+Renderer::Renderer() {
+    sheepDirty = true;
+    stress = false;
+
+    // No texture is ever loaded into this; binding 0 keeps the ground,
+    // tree and treetop draws well defined.
+    textureObject = 0;
+
+    scenePath = ":/sheep.scene";
+
+    width = 0;
+    height = 0;
+    viewMatrix = mat4(1.0f);
+    cameraDirty = true;
+
+    cullDirty = true;
+    sheepDrawCount = 0;
+
+    reflectionWidth = 0;
+    reflectionHeight = 0;
+    reflectionScale = .5f;
+    reflecting = false;
+    reflectionSheepCount = 0;
+
+    shadowCascades = defaultCascades;
+    shadowSize = defaultShadowSize;
+    shadowsChanged = true;
+    shadowsStale = true;
+    shadowLight = vec3(0);
+    for(int i = 0; i < maxCascades; i++) {
+        cascades[i].staticDirty = true;
+        cascades[i].sheepCount = 0;
+    }
+    particleTime = 0;
+    windTime = 0;
+    cullStats.visibleObjects = 0;
+    cullStats.culledObjects = 0;
+    cullStats.visibleSheep = 0;
+    cullStats.culledSheep = 0;
+    cullStats.nodesTested = 0;
+}
+
+void Renderer::setCamera(const mat4 &view, vec3 position) {
+    viewMatrix = view;
+    cameraPosition = position;
+    cameraDirty = true;
+    cullDirty = true;
+}
+
+void Renderer::setStressMode(bool enabled) {
+    if(stress != enabled) {
+        stress = enabled;
+        sheepDirty = true;
+    }
+}
+
+void Renderer::setDefaultShadows(int cascades, int size) {
+    defaultCascades = std::min(maxCascades, std::max(0, cascades));
+    defaultShadowSize = std::max(16, size);
+}
+
+void Renderer::setShadows(int count, int size) {
+    count = std::min(maxCascades, std::max(0, count));
+    size = std::max(16, size);
+    if(count != shadowCascades || size != shadowSize) {
+        shadowCascades = count;
+        shadowSize = size;
+        shadowsChanged = true;
+        cullDirty = true;
+    }
+}
+
+void Renderer::setDefaultParticles(int count, bool cpu) {
+    defaultParticles = std::max(0, count);
+    defaultCpuParticles = cpu;
+}
+
+void Renderer::setInverseNormals(bool enabled) {
+    GLuint programs[] = { cubeProg, sheepProg, waterProg };
+    for(int i = 0; i < 3; i++) {
+        glUseProgram(programs[i]);
+        glUniform1i(glGetUniformLocation(programs[i], "inverseNormals"), enabled);
+    }
+    glUseProgram(0);
+}
+
+void Renderer::initializeGrid() {
+    glGenVertexArrays(1, &gridVao);
+    glBindVertexArray(gridVao);
+
+    // Create a buffer on the GPU for position data
+    GLuint positionBuffer;
+    glGenBuffers(1, &positionBuffer);
+
+    vec3 pts[84];
+    for(int i = -10; i <= 10; i++) {
+
+        pts[2*(i+10)] = vec3(i, -.5f, 10);
+        pts[2*(i+10)+1] = vec3(i, -.5f, -10);
+
+        pts[2*(i+10)+42] = vec3(10,-.5f, i);
+        pts[2*(i+10)+43] = vec3(-10,-.5f, i);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pts), pts, GL_STATIC_DRAW);
+
+    // Load our vertex and fragment shaders into a program object
+    // on the GPU
+    GLuint program = loadShaders(":/grid_vert.glsl", ":/grid_frag.glsl");
+    glUseProgram(program);
+    gridProg = program;
+
+    // Bind the attribute "position" (defined in our vertex shader)
+    // to the currently bound buffer object, which contains our
+    GLint positionIndex = glGetAttribLocation(program, "position");
+    glEnableVertexAttribArray(positionIndex);
+    glVertexAttribPointer(positionIndex, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    // position data for a single triangle. This information
+    // is stored in our vertex array object.
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+
+    gridModelMatrixLoc = glGetUniformLocation(program, "model");
+}
+
+// The unit cube, as quads drawn with triangle fans and primitive restart.
+static const vec3 cubePoints[] = {
+    // top
+    vec3(1,1,1),    // 0
+    vec3(1,1,-1),   // 1
+    vec3(-1,1,-1),  // 2
+    vec3(-1,1,1),   // 3
+
+    // bottom
+    vec3(1,-1,1),   // 4
+    vec3(-1,-1,1),  // 5
+    vec3(-1,-1,-1), // 6
+    vec3(1,-1,-1),  // 7
+
+    // front
+    vec3(1,1,1),    // 8
+    vec3(-1,1,1),   // 9
+    vec3(-1,-1,1),  // 10
+    vec3(1,-1,1),   // 11
+
+    // back
+    vec3(-1,-1,-1), // 12
+    vec3(-1,1,-1),  // 13
+    vec3(1,1,-1),   // 14
+    vec3(1,-1,-1),  // 15
+
+    // right
+    vec3(1,-1,1),   // 16
+    vec3(1,-1,-1),  // 17
+    vec3(1,1,-1),   // 18
+    vec3(1,1,1),     // 19
+
+    // left
+    vec3(-1,-1,1),  // 20
+    vec3(-1,1,1),   // 21
+    vec3(-1,1,-1),  // 22
+    vec3(-1,-1,-1) // 23
+
+};
+
+static const vec3 cubeNormals[] = {
+    // top
+    vec3(0,1,0),    // 0
+    vec3(0,1,0),   // 1
+    vec3(0,1,0),  // 2
+    vec3(0,1,0),   // 3
+
+    // bottom
+    vec3(0,-1,0),   // 4
+    vec3(0,-1,0),  // 5
+    vec3(0,-1,0), // 6
+    vec3(0,-1,0),  // 7
+
+    // front
+    vec3(0,0,1),    // 8
+    vec3(0,0,1),   // 9
+    vec3(0,0,1),  // 10
+    vec3(0,0,1),   // 11
+
+    // back
+    vec3(0,0,-1), // 12
+    vec3(0,0,-1),  // 13
+    vec3(0,0,-1),   // 14
+    vec3(0,0,-1),  // 15
+
+    // right
+    vec3(1,0,0),   // 16
+    vec3(1,0,0),  // 17
+    vec3(1,0,0),   // 18
+    vec3(1,0,0),     // 19
+
+    // left
+    vec3(-1,0,0),  // 20
+    vec3(-1,0,0),   // 21
+    vec3(-1,0,0),  // 22
+    vec3(-1,0,0) // 23
+
+};
+
+static const GLuint restart = 0xFFFFFFFF;
+static const GLuint cubeIndices[] = {
+    0,1,2,3, restart,
+    4,5,6,7, restart,
+    8,9,10,11, restart,
+    12,13,14,15, restart,
+    16,17,18,19, restart,
+    20,21,22,23
+};
+
+void Renderer::initializeCube() {
+    vec3 pts[24];
+    for(int i = 0; i < 24; i++) {
+        pts[i] = cubePoints[i] * .5f;
+    }
+
+    // Every box in the scene is this one cube, fitted to size by its
+    // material's shape matrix, and drawn with this one program.
+    cubeMesh = resources.mesh(pts, cubeNormals, 24, cubeIndices, 29);
+    cubeProg = loadShaders(":/cube_vert.glsl", ":/cube_frag.glsl");
+}
+
+// Each sheep is this many cubes: its body, four heads and four backs of
+// heads (only as many as it has are drawn), four legs and four feet.
+static const int sheepPartCount = 17;
+
+void Renderer::initializeSheep() {
+    // The parts are baked into one mesh, every vertex tagged with the
+    // part it belongs to, and the vertex shader puts each part where it
+    // goes for that sheep's pose. All that comes from the CPU is one
+    // SheepInstance per sheep.
+    std::vector<vec3> pts;
+    std::vector<vec3> normals;
+    std::vector<float> parts;
+    std::vector<GLuint> indices;
+    for(int part = 0; part < sheepPartCount; part++) {
+        if(part > 0) {
+            indices.push_back(restart);
+        }
+        GLuint first = (GLuint)pts.size();
+        for(int i = 0; i < 24; i++) {
+            pts.push_back(cubePoints[i] * .5f);
+            normals.push_back(cubeNormals[i]);
+            parts.push_back((float)part);
+        }
+        for(int i = 0; i < 29; i++) {
+            indices.push_back(cubeIndices[i] == restart ? restart : first + cubeIndices[i]);
+        }
+    }
+    sheepMesh = resources.mesh(&pts[0], &normals[0], (int)pts.size(), &indices[0], (int)indices.size());
+
+    glGenBuffers(1, &sheepPartBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, sheepPartBuffer);
+    glBufferData(GL_ARRAY_BUFFER, parts.size() * sizeof(float), &parts[0], GL_STATIC_DRAW);
+
+    sheepProg = loadShaders(":/sheep_vert.glsl", ":/cube_frag.glsl");
+    glGenBuffers(1, &sheepInstanceBuffer);
+    sheepVao = sheepVertexArray(sheepInstanceBuffer);
+
+    sheepMaterial.id = 1;
+    sheepMaterial.shape = mat4(1.0);
+    sheepMaterial.topColor = vec3(1,1,1);
+    sheepMaterial.sideColor = vec3(1,1,1);
+    sheepMaterial.bottomColor = vec3(.5f,.5f,.5f);
+    sheepMaterial.ambient = 3;
+    sheepMaterial.shininess = 1;
+    sheepMaterial.speck = .1;
+}
+
+GLuint Renderer::sheepVertexArray(GLuint instanceBuffer) {
+    // The mesh has a VAO of its own, but this one has the instance
+    // records wired in as well.
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, sheepMesh.positionBuffer);
+    glEnableVertexAttribArray(positionAttrib);
+    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, sheepMesh.normalBuffer);
+    glEnableVertexAttribArray(normalAttrib);
+    glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, sheepPartBuffer);
+    glEnableVertexAttribArray(partAttrib);
+    glVertexAttribPointer(partAttrib, 1, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheepMesh.indexBuffer);
+
+    // A mat4 attribute takes up four consecutive locations, one per
+    // column. These advance once per instance instead of once per vertex.
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for(int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(modelAttrib + i);
+        glVertexAttribPointer(modelAttrib + i, 4, GL_FLOAT, GL_FALSE, sizeof(SheepInstance),
+                              (void*)(offsetof(SheepInstance, model) + sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(modelAttrib + i, 1);
+    }
+    glEnableVertexAttribArray(lookAttrib);
+    glVertexAttribPointer(lookAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(SheepInstance),
+                          (void*)offsetof(SheepInstance, look));
+    glVertexAttribDivisor(lookAttrib, 1);
+    glEnableVertexAttribArray(gaitAttrib);
+    glVertexAttribPointer(gaitAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(SheepInstance),
+                          (void*)offsetof(SheepInstance, gait));
+    glVertexAttribDivisor(gaitAttrib, 1);
+    glBindVertexArray(0);
+    return vao;
+}
+
+void Renderer::initializeGround() {
+    // a 50 x 1 x 50 slab
+    groundMaterial.id = 2;
+    groundMaterial.shape = glm::scale(mat4(1.0), vec3(50,1,50));
+    groundMaterial.topColor = vec3(.22,.4,.2);
+    groundMaterial.sideColor = vec3(.11,.2,.1);
+    groundMaterial.bottomColor = vec3(.22,.4,.2);
+    groundMaterial.ambient = 1;
+    groundMaterial.shininess = 1;
+    groundMaterial.speck = .1;
+}
+
+void Renderer::initializeGrass() {
+    // darker at the root than the tip
+    grassMaterial.id = 7;
+    grassMaterial.shape = mat4(1.0f);
+    grassMaterial.topColor = vec3(.3,.5,.22);
+    grassMaterial.sideColor = vec3(.1,.2,.08);
+    grassMaterial.bottomColor = vec3(.1,.2,.08);
+    grassMaterial.ambient = 1;
+    grassMaterial.shininess = 1;
+    grassMaterial.speck = .05;
+    grass.initialize(resources);
+}
+
+// A lumpy ball, squashed flat underneath: an icosahedron split three
+// times over and pushed in and out. Positions are shared between
+// triangles, so it can be simplified.
+static void makeRock(std::vector<vec3> &positions, std::vector<GLuint> &triangles) {
+    const float t = 1.618034f;
+    vec3 corners[] = {
+        vec3(-1, t, 0), vec3(1, t, 0), vec3(-1, -t, 0), vec3(1, -t, 0),
+        vec3(0, -1, t), vec3(0, 1, t), vec3(0, -1, -t), vec3(0, 1, -t),
+        vec3(t, 0, -1), vec3(t, 0, 1), vec3(-t, 0, -1), vec3(-t, 0, 1)
+    };
+    static const GLuint faces[] = {
+        0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+        1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+        3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+        4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1
+    };
+    positions.clear();
+    for(int i = 0; i < 12; i++) {
+        positions.push_back(glm::normalize(corners[i]));
+    }
+    triangles.assign(faces, faces + 60);
+    for(int split = 0; split < 3; split++) {
+        std::map<std::pair<GLuint, GLuint>, GLuint> middles;
+        std::vector<GLuint> finer;
+        for(size_t i = 0; i < triangles.size(); i += 3) {
+            GLuint m[3];
+            for(int k = 0; k < 3; k++) {
+                GLuint a = triangles[i + k], b = triangles[i + (k + 1) % 3];
+                std::pair<GLuint, GLuint> edge(std::min(a, b), std::max(a, b));
+                std::map<std::pair<GLuint, GLuint>, GLuint>::iterator it = middles.find(edge);
+                if(it == middles.end()) {
+                    positions.push_back(glm::normalize(positions[a] + positions[b]));
+                    it = middles.insert(std::make_pair(edge, (GLuint)positions.size() - 1)).first;
+                }
+                m[k] = it->second;
+            }
+            GLuint a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+            GLuint more[] = { a, m[0], m[2],  b, m[1], m[0],  c, m[2], m[1],  m[0], m[1], m[2] };
+            finer.insert(finer.end(), more, more + 12);
+        }
+        triangles.swap(finer);
+    }
+    for(size_t i = 0; i < positions.size(); i++) {
+        vec3 p = positions[i];
+        float lump = .18f * sinf(p.x * 3.1f + 1.3f) * sinf(p.z * 2.7f + .4f) +
+                     .1f * sinf(p.y * 5.3f + p.x * 4.1f) +
+                     .05f * sinf(p.z * 11.0f - p.y * 9.0f);
+        p *= 1 + lump;
+        p.y = std::max(p.y, -.3f);
+        positions[i] = p;
+    }
+}
+
+void Renderer::initializeRocks() {
+    std::vector<vec3> positions;
+    std::vector<GLuint> triangles;
+    makeRock(positions, triangles);
+    QElapsedTimer lodTimer;
+    lodTimer.start();
+    rockMesh.build(resources, positions, triangles, rockLevels);
+    std::cout << "Simplified a " << triangles.size() / 3 << " triangle rock into "
+              << rockMesh.levelCount() << " levels in " << lodTimer.nsecsElapsed() / 1000000.0 << " ms" << std::endl;
+
+    rockMaterial.id = 8;
+    rockMaterial.shape = mat4(1.0);
+    rockMaterial.topColor = vec3(.42,.42,.4);
+    rockMaterial.sideColor = vec3(.3,.3,.29);
+    rockMaterial.bottomColor = vec3(.2,.2,.2);
+    rockMaterial.ambient = .3;
+    rockMaterial.shininess = 4;
+    rockMaterial.speck = .2;
+}
+
+void Renderer::initializeTree() {
+    // a .5 x 1.5 x .5 trunk standing from y = -.5 to 1
+    treeMaterial.id = 3;
+    treeMaterial.shape = glm::translate(mat4(1.0), vec3(0,.25,0)) *
+                         glm::scale(mat4(1.0), vec3(.5,1.5,.5));
+    treeMaterial.topColor = vec3(.23,.15,0);
+    treeMaterial.sideColor = vec3(.23,.15,0);
+    treeMaterial.bottomColor = vec3(.23,.15,0);
+    treeMaterial.ambient = .1;
+    treeMaterial.shininess = 1;
+    treeMaterial.speck = .1;
+}
+
+void Renderer::initializeTop() {
+    // a 1 x .5 x 1 canopy sitting on top of the trunk, y = 1 to 1.5
+    topMaterial.id = 4;
+    topMaterial.shape = glm::translate(mat4(1.0), vec3(0,1.25,0)) *
+                        glm::scale(mat4(1.0), vec3(1,.5,1));
+    topMaterial.topColor = vec3(.11,.2,.1);
+    topMaterial.sideColor = vec3(.11,.2,.1);
+    topMaterial.bottomColor = vec3(.11,.2,.1);
+    topMaterial.ambient = .1;
+    topMaterial.shininess = 1;
+    topMaterial.speck = .1;
+}
+
+void Renderer::initializeStar() {
+    starMaterial.id = 5;
+    starMaterial.shape = mat4(1.0);
+    starMaterial.topColor = vec3(1,1,1);
+    starMaterial.sideColor = vec3(1,1,1);
+    starMaterial.bottomColor = vec3(1,1,1);
+    starMaterial.ambient = 10;
+    starMaterial.shininess = 1;
+    starMaterial.speck = .1;
+}
+
+void Renderer::initializeWater() {
+    // a 10 x 1 x 10 pool
+    waterMaterial.id = 6;
+    waterMaterial.shape = glm::scale(mat4(1.0), vec3(10,1,10));
+    waterMaterial.topColor = vec3(.15,.44,.38);
+    waterMaterial.sideColor = vec3(.15,.44,.38);
+    waterMaterial.bottomColor = vec3(.15,.44,.38);
+    waterMaterial.ambient = .1;
+    waterMaterial.shininess = 2;
+    waterMaterial.speck = .7;
+}
+
+void Renderer::initialize() {
+    initializeOpenGLFunctions();
+    resources.initialize(this);
+    prof.initialize();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glPointSize(4.0f);
+
+    initializeCube();
+    initializeSheep();
+    initializeGrid();
+    initializeGround();
+    initializeTree();
+    initializeTop();
+    initializeWater();
+    initializeStar();
+    terrain.initialize(resources);
+    initializeGrass();
+    initializeRocks();
+    initializeChunks();
+    initializeReflection();
+    initializeShadows();
+    particles.initialize(resources, defaultParticles, defaultCpuParticles);
+
+    QElapsedTimer sceneTimer;
+    sceneTimer.start();
+    if(scene.load(scenePath)) {
+        std::cout << "Loaded " << scenePath.toStdString() << " in "
+                  << sceneTimer.nsecsElapsed() / 1000000.0 << " ms, "
+                  << scene.sheepCount() << " sheep" << std::endl;
+    }
+    initializeScene();
+
+    modelMatrix = mat4(1.0f);
+    ltPos = vec3(17*3,30,-17*3);
+
+    // Every program's Camera block reads from this one buffer (see
+    // loadShaders), so the camera goes up once per frame no matter how
+    // many programs there are.
+    glGenBuffers(1, &cameraUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cameraUbo);
+    cameraDirty = true;
+
+    const ResourceManager::Stats &stats = resources.stats();
+    std::cout << stats.programsCreated << " of " << stats.programRequests << " programs and "
+              << stats.meshesCreated << " of " << stats.meshRequests << " meshes created, "
+              << stats.bufferBytes << " bytes of vertex data" << std::endl;
+}
+
+void Renderer::resize(int w, int h) {
+    width = w;
+    height = h;
+
+    float aspect = (float)w/h;
+
+    projMatrix = perspective(45.0f, aspect, .01f, farPlane);
+    cameraDirty = true;
+    cullDirty = true;
+    resizeReflection();
+}
+
+void Renderer::printQueueStats() const {
+    const RenderQueue::Stats &stats = renderQueue.stats();
+    std::cout << stats.draws << " draws, "
+              << stats.programChanges << " program, "
+              << stats.vaoChanges << " vao, "
+              << stats.textureChanges << " texture, "
+              << stats.materialChanges << " material changes, "
+              << stats.savedChanges << " state changes saved" << std::endl;
+    std::cout << cullStats.visibleObjects << " objects visible, "
+              << cullStats.culledObjects << " culled, "
+              << cullStats.visibleSheep << " sheep visible, "
+              << cullStats.culledSheep << " culled, "
+              << cullStats.nodesTested << " bvh nodes tested" << std::endl;
+    const ChunkStreamer::Stats &chunkStats = chunks.stats();
+    std::cout << chunkStats.resident << " chunks resident of " << chunkStats.wanted << " wanted, "
+              << chunkStats.uploads << " uploaded in " << chunkStats.uploadNanos / 1000000.0 << " ms, "
+              << chunkStats.evictions << " evicted, "
+              << impostors.count() << " trees as impostors" << std::endl;
+    std::vector<int> rocksAt(rockMesh.levelCount(), 0);
+    for(size_t i = 0; i < visibleRocks.size(); i++) {
+        rocksAt[rocks[visibleRocks[i]].lod]++;
+    }
+    std::cout << visibleRocks.size() << " rocks visible, by level of detail:";
+    for(int l = 0; l < rockMesh.levelCount(); l++) {
+        std::cout << " " << rocksAt[l] << " (" << rockMesh.level(l).indexCount / 3 << " triangles)";
+    }
+    std::cout << std::endl;
+    const Grass::Stats &grassStats = grass.stats();
+    std::cout << grassStats.blades << " blades of grass in " << grassStats.tiles << " tiles, "
+              << grassStats.builds << " tiles made in " << grassStats.buildNanos / 1000000.0 << " ms, "
+              << grassStats.cachedBlades << " blades cached, "
+              << grassStats.evictions << " tiles evicted" << std::endl;
+}
+
+void Renderer::uploadCamera() {
+    CameraBlock block;
+    block.projection = projMatrix;
+    block.view = viewMatrix;
+    block.cameraPos = glm::vec4(cameraPosition, 1);
+    block.lightPos = glm::vec4(ltPos, 1);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+    cameraDirty = false;
+}
+
+float Renderer::viewDepth(const mat4 &transform) {
+    return -(viewMatrix * transform[3]).z;
+}
+
+void Renderer::renderGrid() {
+    glUseProgram(gridProg);
+    glBindVertexArray(gridVao);
+    glDrawArrays(GL_LINES, 0, 84);
+}
+
+void Renderer::renderBox(const SceneObject &object) {
+    // The lake only has anything to show in its mirror when the
+    // reflection pass ran.
+    bool mirror = object.pass == waterPass && reflecting;
+    renderQueue.submit(object.pass, mirror ? waterProg : cubeProg, cubeMesh.vao,
+                       mirror ? reflectionTexture : textureObject, object.material,
+                       object.transform, object.normal, viewDepth(object.transform),
+                       GL_TRIANGLE_FAN, cubeMesh.indexCount);
+}
+
+void Renderer::addStatic(RenderPass pass, const Material &material, mat4 transform) {
+    SceneObject object;
+    object.pass = pass;
+    object.material = &material;
+    object.transform = transform;
+    object.normal = normalMatrix(transform);
+    // The cube is a unit cube around the origin before its shape matrix.
+    object.bounds = Aabb(vec3(-.5f), vec3(.5f)).transformed(transform * material.shape);
+    statics.push_back(object);
+}
+
+void Renderer::initializeScene() {
+    // Everything but the sheep stays where the scene file puts it, so
+    // it's placed once here and culled through a BVH every frame.
+    statics.clear();
+
+    // The ground slabs aren't drawn; the terrain is raised to fit them.
+    groundSlabs.clear();
+    const mat4 *m = scene.transforms(groundArray);
+    for(int i = 0; i < scene.count(groundArray); i++) {
+        groundSlabs.push_back(Aabb(vec3(-.5f), vec3(.5f)).transformed(m[i] * groundMaterial.shape));
+    }
+    QElapsedTimer heightTimer;
+    heightTimer.start();
+    heightfield.build(groundSlabs, heightfieldSize, heightfieldSpacing);
+    terrain.setHeightfield(heightfield);
+    std::cout << "Built the terrain in " << heightTimer.nsecsElapsed() / 1000000.0 << " ms" << std::endl;
+
+    m = scene.transforms(treeArray);
+    for(int i = 0; i < scene.count(treeArray); i++) {
+        addStatic(treePass, treeMaterial, m[i]);
+        addStatic(treePass, topMaterial, m[i]);
+    }
+    m = scene.transforms(waterArray);
+    for(int i = 0; i < scene.count(waterArray); i++) {
+        addStatic(waterPass, waterMaterial, m[i]);
+    }
+    m = scene.transforms(moonArray);
+    for(int i = 0; i < scene.count(moonArray); i++) {
+        addStatic(moonPass, starMaterial, m[i]);
+    }
+
+    std::vector<Aabb> bounds;
+    for(size_t i = 0; i < statics.size(); i++) {
+        bounds.push_back(statics[i].bounds);
+    }
+    staticBvh.build(bounds);
+    cullDirty = true;
+
+    // The scene's ground is home; the streamed pasture goes round it.
+    Aabb home;
+    for(size_t i = 0; i < groundSlabs.size(); i++) {
+        home.grow(groundSlabs[i]);
+    }
+    chunks.setHome(home);
+    chunks.setGround(&heightfield);
+
+    std::vector<Aabb> lake;
+    for(size_t i = 0; i < statics.size(); i++) {
+        if(statics[i].pass == waterPass) {
+            lake.push_back(statics[i].bounds);
+        }
+    }
+    grass.setGround(&heightfield, lake);
+    placeRocks();
+
+    placeParticles();
+}
+
+void Renderer::initializeChunks() {
+    chunkProg = loadShaders(":/chunk_vert.glsl", ":/cube_frag.glsl");
+    chunks.initialize(cubeMesh, chunkSlots);
+
+    glUseProgram(chunkProg);
+    glUniform1f(glGetUniformLocation(chunkProg, "impostorDistance"), Impostors::fadeEnd);
+    glUseProgram(0);
+    impostors.initialize(resources);
+    QElapsedTimer bakeTimer;
+    bakeTimer.start();
+    const Material *parts[] = { &treeMaterial, &topMaterial };
+    impostors.bake(cubeMesh, parts, 2);
+    std::cout << "Baked " << Impostors::views << " tree impostors in "
+              << bakeTimer.nsecsElapsed() / 1000000.0 << " ms" << std::endl;
+}
+
+void Renderer::renderChunks() {
+    for(size_t i = 0; i < visibleChunks.size(); i++) {
+        int slot = visibleChunks[i];
+        // Every tree in it is only an impostor by now.
+        const Aabb &box = chunks.bounds(slot);
+        if(glm::length(glm::clamp(cameraPosition, box.min, box.max) - cameraPosition) > Impostors::fadeEnd) {
+            continue;
+        }
+        float depth = -(viewMatrix * vec4(box.center(), 1)).z;
+        renderQueue.submit(treePass, chunkProg, chunks.treeVao(slot), textureObject, &treeMaterial,
+                           mat4(1.0f), mat3(1.0f), depth, GL_TRIANGLE_FAN, cubeMesh.indexCount,
+                           chunks.treeCount(slot));
+        renderQueue.submit(treePass, chunkProg, chunks.treeVao(slot), textureObject, &topMaterial,
+                           mat4(1.0f), mat3(1.0f), depth, GL_TRIANGLE_FAN, cubeMesh.indexCount,
+                           chunks.treeCount(slot));
+    }
+    if(impostors.count() > 0) {
+        renderQueue.submit(treePass, impostors.program(), impostors.vertexArray(), impostors.texture(),
+                           &topMaterial, mat4(1.0f), mat3(1.0f), Impostors::fadeEnd, GL_TRIANGLES,
+                           impostors.indexCount(), impostors.count());
+    }
+}
+
+void Renderer::renderGrass() {
+    prof.beginCpu("grass");
+    grass.update(Frustum(projMatrix * viewMatrix), cameraPosition, windTime);
+    const std::vector<Grass::Draw> &draws = grass.draws();
+    for(size_t i = 0; i < draws.size(); i++) {
+        renderQueue.submit(grassPass, grass.program(), draws[i].vao, textureObject, &grassMaterial,
+                           draws[i].model, mat3(1.0f), draws[i].distance, GL_TRIANGLES,
+                           grass.indexCount(), draws[i].count);
+    }
+    prof.endCpu();
+}
+
+void Renderer::placeRocks() {
+    // Scattered over the scene's ground, the same ones every time, half
+    // sunk into it and kept out of the lake.
+    rocks.clear();
+    Aabb home;
+    for(size_t i = 0; i < groundSlabs.size(); i++) {
+        home.grow(groundSlabs[i]);
+    }
+    if(groundSlabs.empty()) {
+        return;
+    }
+    uint32_t h = 2166136261u;
+    for(int tries = 0; tries < rockCount * 4 && (int)rocks.size() < rockCount; tries++) {
+        h = (h ^ (uint32_t)tries) * 16777619u;
+        float u = (h & 0xFFFF) / 65535.0f;
+        float v = (h >> 16) / 65535.0f;
+        h = h * 747796405u + 2891336453u;
+        float x = home.min.x + u * (home.max.x - home.min.x);
+        float z = home.min.z + v * (home.max.z - home.min.z);
+        bool wet = false;
+        for(size_t i = 0; i < statics.size(); i++) {
+            const Aabb &b = statics[i].bounds;
+            if(statics[i].pass == waterPass && x > b.min.x - 1 && x < b.max.x + 1 && z > b.min.z - 1 && z < b.max.z + 1) {
+                wet = true;
+            }
+        }
+        if(wet) {
+            continue;
+        }
+
+        Rock rock;
+        rock.scale = .15f + .35f * ((h >> 8) & 0xFF) / 255.0f;
+        float turn = ((h >> 16) & 0xFF) / 255.0f * 6.2831853f;
+        vec3 at(x, heightfield.height(x, z) + rock.scale * .1f, z);
+        rock.transform = glm::translate(mat4(1.0), at) *
+                         glm::rotate(mat4(1.0), turn, vec3(0, 1, 0)) *
+                         glm::scale(mat4(1.0), vec3(rock.scale));
+        rock.normal = normalMatrix(rock.transform);
+        rock.center = at;
+        rock.lod = 0;
+        rocks.push_back(rock);
+    }
+}
+
+void Renderer::renderRocks() {
+    for(size_t i = 0; i < visibleRocks.size(); i++) {
+        const Rock &rock = rocks[visibleRocks[i]];
+        const LodMesh::Level &level = rockMesh.level(rock.lod);
+        renderQueue.submit(groundPass, cubeProg, rockMesh.vertexArray(), textureObject, &rockMaterial,
+                           rock.transform, rock.normal, viewDepth(rock.transform), GL_TRIANGLES,
+                           level.indexCount, 1, level.firstIndex, level.baseVertex);
+    }
+}
+
+void Renderer::placeParticles() {
+    // The biggest slab of ground is the meadow; the hill sits on it.
+    Aabb meadow(vec3(-1, -.5f, -1), vec3(1, -.5f, 1));
+    float meadowArea = -1;
+    for(size_t i = 0; i < groundSlabs.size(); i++) {
+        vec3 size = groundSlabs[i].max - groundSlabs[i].min;
+        if(size.x * size.z > meadowArea) {
+            meadow = groundSlabs[i];
+            meadowArea = size.x * size.z;
+        }
+    }
+    Aabb lake;
+    bool haveLake = false;
+    std::vector<Aabb> treeTops;
+    for(size_t i = 0; i < statics.size(); i++) {
+        const SceneObject &object = statics[i];
+        if(object.pass == waterPass) {
+            if(haveLake) {
+                lake.grow(object.bounds);
+            } else {
+                lake = object.bounds;
+                haveLake = true;
+            }
+        } else if(object.material == &topMaterial) {
+            treeTops.push_back(object.bounds);
+        }
+    }
+    // No lake, no mist to speak of: a thin layer over the meadow.
+    if(!haveLake) {
+        lake = Aabb(vec3(meadow.min.x, meadow.max.y, meadow.min.z), meadow.max);
+    }
+    particles.setEmitters(meadow, lake, treeTops);
+}
+
+void Renderer::renderParticles() {
+    prof.beginCpu("particles");
+    prof.beginGpu("particles");
+    particles.update(particleTime);
+    particleTime = 0;
+    particles.render(height);
+    prof.endGpu();
+    prof.endCpu();
+}
+
+void Renderer::cull() {
+    Frustum frustum(projMatrix * viewMatrix);
+
+    visibleStatics.clear();
+    cullStats.nodesTested = staticBvh.query(frustum, visibleStatics);
+    cullStats.visibleObjects = (int)visibleStatics.size();
+    cullStats.culledObjects = (int)statics.size() - cullStats.visibleObjects;
+
+    visibleChunks.clear();
+    chunks.cull(frustum, visibleChunks);
+    farTrees.clear();
+    for(size_t i = 0; i < visibleChunks.size(); i++) {
+        const std::vector<vec3> &trees = chunks.treePositions(visibleChunks[i]);
+        for(size_t t = 0; t < trees.size(); t++) {
+            if(glm::length(trees[t] - cameraPosition) > Impostors::fadeStart) {
+                farTrees.push_back(trees[t]);
+            }
+        }
+    }
+    impostors.setTrees(farTrees);
+
+    // Rocks in view, each at the coarsest level that's within rockPixels
+    // of the full mesh on screen.
+    visibleRocks.clear();
+    float pixelsPerUnit = projMatrix[1][1] * height * .5f;
+    for(size_t i = 0; i < rocks.size(); i++) {
+        Rock &rock = rocks[i];
+        float r = rockMesh.radius() * rock.scale;
+        if(frustum.classify(Aabb(rock.center - vec3(r), rock.center + vec3(r))) == Frustum::outside) {
+            continue;
+        }
+        rock.lod = rockMesh.select(glm::length(rock.center - cameraPosition), rock.scale, pixelsPerUnit,
+                                   rockPixels, rock.lod);
+        visibleRocks.push_back((int)i);
+    }
+    terrain.select(frustum, cameraPosition, farPlane);
+
+    cullSheep(frustum);
+    cullShadows();
+    cullReflection();
+    cullDirty = false;
+}
+
+void Renderer::render() {
+    prof.beginFrame();
+    prof.beginCpu("render");
+
+    // Set every frame rather than once, something else (the profiler
+    // overlay's QPainter) may have drawn into this context since.
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
+    GLuint restart = 0xFFFFFFFF;
+    glPrimitiveRestartIndex(restart);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cameraUbo);
+
+    if(cameraDirty) {
+        uploadCamera();
+    }
+    //renderGrid();
+
+    if(sheepDirty) {
+        buildFlock();
+    }
+    updateSheep();
+    if(shadowsChanged) {
+        allocateShadows();
+    }
+    prof.beginCpu("chunks");
+    if(chunks.update(cameraPosition, farPlane)) {
+        cullDirty = true;
+    }
+    prof.endCpu();
+    if(cullDirty) {
+        cull();
+    }
+    renderShadows();
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::shadowBinding, shadowUbo);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+    glActiveTexture(GL_TEXTURE0);
+    renderReflection();
+
+    prof.beginGpu("clear");
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    prof.endGpu();
+    renderQueue.clear();
+
+    renderSheep();
+    for(size_t i = 0; i < visibleStatics.size(); i++) {
+        renderBox(statics[visibleStatics[i]]);
+    }
+    renderChunks();
+    if(terrain.patchCount() > 0) {
+        renderQueue.submit(groundPass, terrain.program(), terrain.vertexArray(), terrain.texture(),
+                           &groundMaterial, mat4(1.0f), mat3(1.0f), 0, GL_TRIANGLES,
+                           terrain.indexCount(), terrain.patchCount());
+    }
+    renderGrass();
+    renderRocks();
+
+    renderQueue.sort();
+
+    static const char *passNames[passCount] = { "sheep", "ground", "grass", "trees", "water", "moon" };
+    for(int pass = 0; pass < passCount; pass++) {
+        prof.beginGpu(passNames[pass]);
+        renderQueue.flush(this, pass);
+        prof.endGpu();
+    }
+    renderQueue.finish();
+    renderParticles();
+
+    prof.endCpu();
+    prof.endFrame();
+}
+
+// Sheep further than this from the lake, in world units, never show up
+// in it.
+static const float shoreDistance = 2.0f;
+
+// Swaps the near plane of a perspective projection for plane, given in
+// view space, so nothing on the wrong side of it is drawn; Lengyel's
+// oblique near plane trick. The far plane tilts to match, but stays
+// further out than anything the scene has.
+static mat4 obliqueProjection(mat4 projection, const vec4 &plane) {
+    vec4 q;
+    q.x = ((plane.x > 0) - (plane.x < 0) + projection[2][0]) / projection[0][0];
+    q.y = ((plane.y > 0) - (plane.y < 0) + projection[2][1]) / projection[1][1];
+    q.z = -1;
+    q.w = (1 + projection[2][2]) / projection[3][2];
+    vec4 c = plane * (2 / glm::dot(plane, q));
+    projection[0][2] = c.x - projection[0][3];
+    projection[1][2] = c.y - projection[1][3];
+    projection[2][2] = c.z - projection[2][3];
+    projection[3][2] = c.w - projection[3][3];
+    return projection;
+}
+
+void Renderer::initializeReflection() {
+    waterProg = loadShaders(":/cube_vert.glsl", ":/water_frag.glsl");
+    glUseProgram(waterProg);
+    glUniform1i(glGetUniformLocation(waterProg, "reflection"), 0);
+    glUseProgram(0);
+
+    glGenTextures(1, &reflectionTexture);
+    glBindTexture(GL_TEXTURE_2D, reflectionTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenRenderbuffers(1, &reflectionDepth);
+    glGenFramebuffers(1, &reflectionFbo);
+
+    glGenBuffers(1, &reflectionCameraUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, reflectionCameraUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &reflectionSheepBuffer);
+    reflectionSheepVao = sheepVertexArray(reflectionSheepBuffer);
+}
+
+void Renderer::resizeReflection() {
+    // Big enough for the largest fraction; smaller ones use a corner.
+    int w = std::max(1, (width + 1) / 2);
+    int h = std::max(1, (height + 1) / 2);
+    if(w == reflectionWidth && h == reflectionHeight) {
+        return;
+    }
+    reflectionWidth = w;
+    reflectionHeight = h;
+
+    GLint framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glBindTexture(GL_TEXTURE_2D, reflectionTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, reflectionDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, reflectionFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reflectionTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, reflectionDepth);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Reflection framebuffer incomplete, the lake won't reflect" << std::endl;
+        reflectionWidth = 0;
+        reflectionHeight = 0;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    cullDirty = true;
+}
+
+void Renderer::cullReflection() {
+    reflecting = false;
+    reflectionSheepCount = 0;
+    if(reflectionWidth == 0) {
+        return;
+    }
+
+    // The lake's surface, if any of it is in view and the camera's above
+    // it.
+    Aabb lake;
+    for(size_t i = 0; i < visibleStatics.size(); i++) {
+        const SceneObject &object = statics[visibleStatics[i]];
+        if(object.pass == waterPass) {
+            lake.grow(object.bounds);
+        }
+    }
+    if(lake.min.x > lake.max.x || cameraPosition.y <= lake.max.y) {
+        return;
+    }
+    float surface = lake.max.y;
+
+    // Where the surface is on screen. Corners behind the camera could be
+    // anywhere, so then it's the whole screen.
+    mat4 viewProjection = projMatrix * viewMatrix;
+    vec2 low(1), high(-1);
+    for(int i = 0; i < 4; i++) {
+        vec4 corner = viewProjection * vec4(i & 1 ? lake.max.x : lake.min.x, surface,
+                                            i & 2 ? lake.max.z : lake.min.z, 1);
+        if(corner.w <= 0) {
+            low = vec2(-1);
+            high = vec2(1);
+            break;
+        }
+        low = glm::min(low, vec2(corner.x, corner.y) / corner.w);
+        high = glm::max(high, vec2(corner.x, corner.y) / corner.w);
+    }
+    low = glm::max(low, vec2(-1));
+    high = glm::min(high, vec2(1));
+    if(low.x >= high.x || low.y >= high.y) {
+        return;
+    }
+
+    // A lake filling the screen gets half its resolution, a small or far
+    // off one as little as a quarter, in eighths so it doesn't flicker
+    // between sizes with every step the camera takes.
+    float coverage = std::max(high.x - low.x, high.y - low.y) / 2;
+    reflectionScale = std::min(.5f, std::max(.25f, ceilf(coverage * 8) / 8));
+    float w = width * reflectionScale;
+    float h = height * reflectionScale;
+    reflectionRect[0] = std::max(0, (int)((low.x + 1) / 2 * w) - 1);
+    reflectionRect[1] = std::max(0, (int)((low.y + 1) / 2 * h) - 1);
+    reflectionRect[2] = std::min(reflectionWidth, (int)ceilf((high.x + 1) / 2 * w) + 1) - reflectionRect[0];
+    reflectionRect[3] = std::min(reflectionHeight, (int)ceilf((high.y + 1) / 2 * h) + 1) - reflectionRect[1];
+    if(reflectionRect[2] <= 0 || reflectionRect[3] <= 0) {
+        return;
+    }
+
+    // The mirrored camera sees the world flipped about the surface, so
+    // what it draws at a pixel is what's reflected there. Everything
+    // under the surface is clipped away by the near plane.
+    mat4 mirror = glm::translate(mat4(1.0), vec3(0, 2 * surface, 0)) *
+                  glm::scale(mat4(1.0), vec3(1, -1, 1));
+    mat4 view = viewMatrix * mirror;
+    vec4 plane = glm::transpose(glm::inverse(view)) * vec4(0, 1, 0, -surface);
+    mat4 projection = obliqueProjection(projMatrix, plane);
+
+    CameraBlock block;
+    block.projection = projection;
+    block.view = view;
+    block.cameraPos = vec4(cameraPosition.x, 2 * surface - cameraPosition.y, cameraPosition.z, 1);
+    block.lightPos = vec4(ltPos, 1);
+    glBindBuffer(GL_UNIFORM_BUFFER, reflectionCameraUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+
+    // Of what the mirrored camera sees, only the trees, the moon and the
+    // sheep by the shore are worth drawing; the meadow is too flat to
+    // show up.
+    Frustum frustum(projection * view);
+    reflectionStatics.clear();
+    staticBvh.query(frustum, reflectionStatics);
+    size_t kept = 0;
+    for(size_t i = 0; i < reflectionStatics.size(); i++) {
+        RenderPass pass = statics[reflectionStatics[i]].pass;
+        if(pass == treePass || pass == moonPass) {
+            reflectionStatics[kept++] = reflectionStatics[i];
+        }
+    }
+    reflectionStatics.resize(kept);
+
+    int count = (int)sheepRoot.size();
+    reflectionSheepVisible.resize(count);
+    Aabb shore(lake.min - vec3(shoreDistance), lake.max + vec3(shoreDistance));
+    JobSystem::instance().parallelFor(count, 2048, [&](int begin, int end) {
+        frustum.testSpheres(&sheepX[begin], &sheepY[begin], &sheepZ[begin], &sheepR[begin],
+                            end - begin, &reflectionSheepVisible[begin]);
+        for(int i = begin; i < end; i++) {
+            if(sheepX[i] < shore.min.x || sheepX[i] > shore.max.x ||
+               sheepZ[i] < shore.min.z || sheepZ[i] > shore.max.z) {
+                reflectionSheepVisible[i] = 0;
+            }
+        }
+    });
+    reflectionSheepCount = uploadSheep(reflectionSheepBuffer, reflectionSheepVisible);
+    reflecting = true;
+}
+
+void Renderer::renderReflection() {
+    if(!reflecting) {
+        return;
+    }
+    prof.beginGpu("reflection");
+
+    GLint framebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, reflectionFbo);
+    glViewport(0, 0, (int)(width * reflectionScale), (int)(height * reflectionScale));
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(reflectionRect[0], reflectionRect[1], reflectionRect[2], reflectionRect[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, reflectionCameraUbo);
+
+    reflectionQueue.clear();
+    if(reflectionSheepCount > 0) {
+        reflectionQueue.submit(sheepPass, sheepProg, reflectionSheepVao, 0, &sheepMaterial,
+                               mat4(1.0), mat3(1.0), 0, GL_TRIANGLE_FAN, sheepMesh.indexCount,
+                               reflectionSheepCount);
+    }
+    for(size_t i = 0; i < reflectionStatics.size(); i++) {
+        const SceneObject &object = statics[reflectionStatics[i]];
+        reflectionQueue.submit(object.pass, cubeProg, cubeMesh.vao, textureObject, object.material,
+                               object.transform, object.normal, 0,
+                               GL_TRIANGLE_FAN, cubeMesh.indexCount);
+    }
+    reflectionQueue.sort();
+    for(int pass = 0; pass < passCount; pass++) {
+        reflectionQueue.flush(this, pass);
+    }
+    reflectionQueue.finish();
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cameraUbo);
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    // The water finds its reflection from its own pixel on screen.
+    glUseProgram(waterProg);
+    glUniform2f(glGetUniformLocation(waterProg, "reflectionScale"),
+                reflectionScale / reflectionWidth, reflectionScale / reflectionHeight);
+    glUseProgram(0);
+
+    prof.endGpu();
+}
+
+// Shadows reach this far from the camera, in world units.
+static const float shadowDistance = 40.0f;
+// Between even and logarithmic cascade splits; more is more logarithmic.
+static const float splitBlend = .7f;
+// How much bigger than its slice of the view a cascade is made, so the
+// camera can move about a while before its statics need drawing again.
+static const float cascadeSlack = 1.3f;
+
+void Renderer::initializeShadows() {
+    cubeShadowProg = loadShaders(":/cube_vert.glsl", ":/shadow_frag.glsl");
+    sheepShadowProg = loadShaders(":/sheep_vert.glsl", ":/shadow_frag.glsl");
+
+    // Everything lit by cube_frag.glsl finds the shadow map on unit 1.
+    GLuint receivers[] = { cubeProg, sheepProg, chunkProg, terrain.program(), grass.program() };
+    for(int i = 0; i < 5; i++) {
+        glUseProgram(receivers[i]);
+        glUniform1i(glGetUniformLocation(receivers[i], "shadowMap"), 1);
+    }
+    glUseProgram(0);
+
+    glGenTextures(1, &shadowMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+    // Compared against in the lookup, with the four nearest texels'
+    // results blended where the hardware does that.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glGenTextures(1, &shadowCache);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadowCache);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &shadowFbo);
+    glGenFramebuffers(1, &shadowCacheFbo);
+
+    glGenBuffers(1, &shadowUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, shadowUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowBlock), NULL, GL_DYNAMIC_DRAW);
+
+    for(int i = 0; i < maxCascades; i++) {
+        Cascade &cascade = cascades[i];
+        glGenBuffers(1, &cascade.cameraUbo);
+        glBindBuffer(GL_UNIFORM_BUFFER, cascade.cameraUbo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &cascade.sheepBuffer);
+        cascade.sheepVao = sheepVertexArray(cascade.sheepBuffer);
+    }
+}
+
+void Renderer::allocateShadows() {
+    // With shadows off the map is a single texel, so the programs that
+    // would sample it still have something bound.
+    int size = shadowCascades > 0 ? shadowSize : 1;
+    int layers = std::max(1, shadowCascades);
+    GLuint maps[] = { shadowMap, shadowCache };
+    for(int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, maps[i]);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0,
+                     GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    GLint framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    GLuint fbos[] = { shadowFbo, shadowCacheFbo };
+    for(int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    for(int i = 0; i < maxCascades; i++) {
+        cascades[i].staticDirty = true;
+    }
+    shadowsChanged = false;
+    shadowsStale = true;
+    cullDirty = true;
+}
+
+void Renderer::cullShadows() {
+    ShadowBlock block;
+    block.params = vec4((float)shadowCascades, 0, 0, 0);
+    if(shadowCascades == 0) {
+        glBindBuffer(GL_UNIFORM_BUFFER, shadowUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowBlock), &block);
+        return;
+    }
+
+    // The moon is far enough off to count as a directional light,
+    // shining towards the middle of the scene.
+    if(ltPos != shadowLight) {
+        shadowLight = ltPos;
+        lightView = glm::lookAt(vec3(0), -glm::normalize(ltPos), vec3(0, 1, 0));
+        for(int i = 0; i < maxCascades; i++) {
+            cascades[i].staticDirty = true;
+        }
+    }
+
+    // Every caster is in range of every cascade, however far up the
+    // light it is.
+    float minZ = FLT_MAX;
+    float maxZ = -FLT_MAX;
+    for(int i = 0; i < 8; i++) {
+        vec3 corner(i & 1 ? casterBounds.max.x : casterBounds.min.x,
+                    i & 2 ? casterBounds.max.y : casterBounds.min.y,
+                    i & 4 ? casterBounds.max.z : casterBounds.min.z);
+        float z = (lightView * vec4(corner, 1)).z;
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
+    float nearZ = -maxZ - 1;
+    float farZ = -minZ + 1;
+
+    // The view is cut into slices from the near plane out to
+    // shadowDistance, one per cascade, and the slices' corners found by
+    // taking NDC corners back through the inverse view projection.
+    mat4 fromNdc = glm::inverse(projMatrix * viewMatrix);
+    float a = projMatrix[2][2];
+    float b = projMatrix[3][2];
+    float cameraNear = b / (a - 1);
+    float cameraFar = b / (a + 1);
+    float reach = std::min(shadowDistance, cameraFar);
+    float sliceNear = cameraNear;
+
+    mat4 bias(vec4(.5f, 0, 0, 0), vec4(0, .5f, 0, 0), vec4(0, 0, .5f, 0), vec4(.5f, .5f, .5f, 1));
+    for(int i = 0; i < shadowCascades; i++) {
+        float f = (float)(i + 1) / shadowCascades;
+        float sliceFar = splitBlend * cameraNear * powf(reach / cameraNear, f) +
+                         (1 - splitBlend) * (cameraNear + (reach - cameraNear) * f);
+
+        vec3 corners[8];
+        vec3 center(0);
+        for(int k = 0; k < 8; k++) {
+            float d = k & 4 ? sliceFar : sliceNear;
+            vec4 p = fromNdc * vec4(k & 1 ? 1 : -1, k & 2 ? 1 : -1, (b - a * d) / d, 1);
+            corners[k] = vec3(p.x, p.y, p.z) / p.w;
+            center += corners[k] / 8.0f;
+        }
+        // A sphere holds the slice however the camera turns, so the
+        // cascade's size only changes along with the projection.
+        float radius = 0;
+        for(int k = 0; k < 8; k++) {
+            radius = std::max(radius, glm::length(corners[k] - center));
+        }
+        radius = ceilf(radius * 16) / 16;
+        sliceNear = sliceFar;
+
+        // Refit only when the slice has wandered out of the cascade.
+        Cascade &cascade = cascades[i];
+        vec4 light = lightView * vec4(center, 1);
+        float halfSize = radius * cascadeSlack;
+        if(cascade.staticDirty || cascade.halfSize != halfSize ||
+           cascade.nearZ != nearZ || cascade.farZ != farZ ||
+           fabsf(light.x - cascade.center.x) + radius > halfSize ||
+           fabsf(light.y - cascade.center.y) + radius > halfSize) {
+            // On whole texels, so the shadows don't crawl as it moves.
+            float texel = 2 * halfSize / shadowSize;
+            cascade.center = vec2(floorf(light.x / texel) * texel, floorf(light.y / texel) * texel);
+            cascade.halfSize = halfSize;
+            cascade.nearZ = nearZ;
+            cascade.farZ = farZ;
+            cascade.staticDirty = true;
+        }
+
+        mat4 projection = glm::ortho(cascade.center.x - halfSize, cascade.center.x + halfSize,
+                                     cascade.center.y - halfSize, cascade.center.y + halfSize,
+                                     nearZ, farZ);
+        Frustum frustum(projection * lightView);
+        if(cascade.staticDirty) {
+            // The trees; the lake is too low to shadow anything, the
+            // moon is the light and the terrain only ever catches
+            // shadows.
+            cascade.statics.clear();
+            staticBvh.query(frustum, cascade.statics);
+            size_t kept = 0;
+            for(size_t k = 0; k < cascade.statics.size(); k++) {
+                RenderPass pass = statics[cascade.statics[k]].pass;
+                if(pass == treePass) {
+                    cascade.statics[kept++] = cascade.statics[k];
+                }
+            }
+            cascade.statics.resize(kept);
+
+            CameraBlock camera;
+            camera.projection = projection;
+            camera.view = lightView;
+            camera.cameraPos = vec4(ltPos, 1);
+            camera.lightPos = vec4(ltPos, 1);
+            glBindBuffer(GL_UNIFORM_BUFFER, cascade.cameraUbo);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &camera);
+        }
+
+        int count = (int)sheepRoot.size();
+        cascade.sheepVisible.resize(count);
+        JobSystem::instance().parallelFor(count, 2048, [&](int begin, int end) {
+            frustum.testSpheres(&sheepX[begin], &sheepY[begin], &sheepZ[begin], &sheepR[begin],
+                                end - begin, &cascade.sheepVisible[begin]);
+        });
+        cascade.sheepCount = uploadSheep(cascade.sheepBuffer, cascade.sheepVisible);
+
+        block.cascades[i] = bias * projection * lightView;
+        block.texels[i] = 2 * halfSize / shadowSize;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, shadowUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowBlock), &block);
+    shadowsStale = true;
+}
+
+void Renderer::renderShadows() {
+    if(shadowCascades == 0 || !shadowsStale) {
+        return;
+    }
+    prof.beginGpu("shadows");
+
+    GLint framebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glViewport(0, 0, shadowSize, shadowSize);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2, 4);
+    for(int i = 0; i < shadowCascades; i++) {
+        Cascade &cascade = cascades[i];
+        glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cascade.cameraUbo);
+
+        if(cascade.staticDirty) {
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowCacheFbo);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCache, 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            shadowQueue.clear();
+            for(size_t k = 0; k < cascade.statics.size(); k++) {
+                const SceneObject &object = statics[cascade.statics[k]];
+                shadowQueue.submit(object.pass, cubeShadowProg, cubeMesh.vao, 0, object.material,
+                                   object.transform, object.normal, 0,
+                                   GL_TRIANGLE_FAN, cubeMesh.indexCount);
+            }
+            shadowQueue.sort();
+            for(int pass = 0; pass < passCount; pass++) {
+                shadowQueue.flush(this, pass);
+            }
+            shadowQueue.finish();
+            cascade.staticDirty = false;
+        }
+
+        // Start from the cached ground and trees, and put the sheep in.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, shadowCacheFbo);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCache, 0, i);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowFbo);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+        glBlitFramebuffer(0, 0, shadowSize, shadowSize, 0, 0, shadowSize, shadowSize,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        if(cascade.sheepCount > 0) {
+            shadowQueue.clear();
+            shadowQueue.submit(sheepPass, sheepShadowProg, cascade.sheepVao, 0, &sheepMaterial,
+                               mat4(1.0), mat3(1.0), 0, GL_TRIANGLE_FAN, sheepMesh.indexCount,
+                               cascade.sheepCount);
+            shadowQueue.sort();
+            shadowQueue.flush(this, sheepPass);
+            shadowQueue.finish();
+        }
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, ResourceManager::cameraBinding, cameraUbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    shadowsStale = false;
+
+    prof.endGpu();
+}
+
+void Renderer::buildFlock() {
+    sheepNodes.clear();
+    sheepRoot.clear();
+    sheepLook.clear();
+
+    // The stress flock isn't part of any scene file, it's made up the
+    // first time it's asked for.
+    if(stress && stressScene.sheepCount() == 0) {
+        stressScene.generateFlock(224);
+    }
+    const Scene &flock = stress ? stressScene : scene;
+
+    mat4 scale = glm::scale(mat4(1.0),vec3(.1,.1,.1));
+    const SheepPlacement *sheep = flock.sheep();
+    sheepNodes.reserve(flock.sheepCount());
+    for(int i = 0; i < flock.sheepCount(); i++) {
+        addSheep(scale, (int)sheep[i].x, (int)sheep[i].z, sheep[i].heads,
+                 sheep[i].turn, sheep[i].nod, sheep[i].fat);
+    }
+
+    sheepVisible.resize(sheepRoot.size());
+    initializeFlock();
+
+    // Only the sheep that pass culling go up to the GPU (see cullSheep),
+    // so the instance buffer is filled in after every cull.
+    sheepDirty = false;
+    cullDirty = true;
+}
+
+void Renderer::initializeFlock() {
+    flock.clear();
+    for(size_t i = 0; i < sheepRoot.size(); i++) {
+        mat4 root = sheepNodes.local(sheepRoot[i]);
+        flock.add(root[3].x, root[3].z, 0);
+    }
+
+    // Sheep are placed at y = 0 and a lot of them start out standing
+    // still, so they're all stood on the ground now rather than when
+    // they first move.
+    for(int i = 0; i < flock.size(); i++) {
+        sheepNodes.setLocal(sheepRoot[i], sheepPlacement(i));
+    }
+
+    // Keep out of the lake and the trees, and on the ground, or at least
+    // no further off it than the flock started out.
+    std::vector<Flock::Obstacle> obstacles;
+    Aabb area;
+    for(size_t i = 0; i < statics.size(); i++) {
+        const Aabb &b = statics[i].bounds;
+        if(statics[i].pass == waterPass || statics[i].pass == treePass) {
+            Flock::Obstacle o = { b.min.x, b.min.z, b.max.x, b.max.z };
+            obstacles.push_back(o);
+        }
+    }
+    for(size_t i = 0; i < groundSlabs.size(); i++) {
+        area.grow(groundSlabs[i]);
+    }
+    for(int i = 0; i < flock.size(); i++) {
+        vec3 ground = vec3(sheepNodes.local(sheepRoot[i])[3]) - vec3(0, .5f, 0);
+        area.grow(Aabb(ground, ground));
+    }
+    flock.setObstacles(obstacles);
+    flock.setBounds(area.min.x, area.min.z, area.max.x, area.max.z);
+
+    // The sheep stay in the area, and stand no more than half a unit
+    // tall on the highest ground in it.
+    float low, high;
+    heightfield.range(area.min.x, area.min.z, area.max.x, area.max.z, low, high);
+    casterBounds = Aabb(vec3(area.min.x, std::min(area.min.y, low), area.min.z),
+                        vec3(area.max.x, std::max(area.max.y, high) + 1, area.max.z));
+    for(size_t i = 0; i < statics.size(); i++) {
+        if(statics[i].pass == treePass) {
+            casterBounds.grow(statics[i].bounds);
+        }
+    }
+    cullDirty = true;
+}
+
+void Renderer::simulate(float dt) {
+    particleTime += dt;
+    windTime += dt;
+
+    // The flock is built on the first frame drawn.
+    if(flock.size() == 0) {
+        return;
+    }
+
+    prof.beginCpu("flock");
+    flock.step(dt);
+
+    JobSystem::instance().parallelFor(flock.size(), 2048, [this](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            if(flock.moved(i)) {
+                sheepNodes.writeLocal(sheepRoot[i], sheepPlacement(i));
+            }
+        }
+    });
+    for(int i = 0; i < flock.size(); i++) {
+        if(flock.moved(i)) {
+            sheepNodes.markDirty(sheepRoot[i]);
+        }
+    }
+    prof.endCpu();
+}
+
+mat4 Renderer::sheepPlacement(int i) const {
+    // Sheep stand on the ground where the flock has them, turned to face
+    // the way they're going, at the same tenth scale as ever. Their feet
+    // are half a unit below the root.
+    float c = cosf(flock.heading(i)) * .1f;
+    float s = sinf(flock.heading(i)) * .1f;
+    float x = flock.positionX(i);
+    float z = flock.positionZ(i);
+    return mat4(vec4(c, 0, -s, 0), vec4(0, .1f, 0, 0), vec4(s, 0, c, 0),
+                vec4(x, heightfield.height(x, z) + .5f, z, 1));
+}
+
+void Renderer::addSheep(mat4 transform,int x,int y, double h,float s, float u, double f) {
+    // The sheep is one node, standing where its body is. Its parts are
+    // posed in sheep_vert.glsl from its look and the flock's gait, so
+    // walking, grazing and nodding never touch the hierarchy.
+    mat4 place = glm::translate(mat4(1.0), vec3(x, 0, y));
+    sheepRoot.push_back(sheepNodes.add(-1, transform * place));
+    sheepLook.push_back(vec4(s, u, f, h));
+}
+
+// Bounding sphere radius of a sheep in any pose, in sheep units.
+static const float sheepRadius = 3.5f;
+
+void Renderer::updateSheepBounds() {
+    // A bounding sphere around every part of each sheep, for culling.
+    int count = (int)sheepRoot.size();
+    sheepX.resize(count);
+    sheepY.resize(count);
+    sheepZ.resize(count);
+    sheepR.resize(count);
+    JobSystem::instance().parallelFor(count, 2048, [this](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            // The parts move about, so this is a sphere that holds them
+            // in any pose: feet down at -4.5, heads up at about -.3 and
+            // out to either end at about 2.5, in sheep units.
+            const mat4 &world = sheepNodes.world(sheepRoot[i]);
+            vec4 center = world * vec4(0, -2.4f, 0, 1);
+            sheepX[i] = center.x;
+            sheepY[i] = center.y;
+            sheepZ[i] = center.z;
+            sheepR[i] = sheepRadius * glm::length(vec3(world[0]));
+        }
+    });
+}
+
+void Renderer::updateSheep() {
+    // Only subtrees that were touched since the last frame get their
+    // world matrices recomputed, and only then does anything need
+    // bounding or uploading again.
+    if(sheepNodes.update() > 0) {
+        updateSheepBounds();
+        cullDirty = true;
+    }
+}
+
+void Renderer::cullSheep(const Frustum &frustum) {
+    int count = (int)sheepRoot.size();
+    JobSystem::instance().parallelFor(count, 2048, [&](int begin, int end) {
+        frustum.testSpheres(&sheepX[begin], &sheepY[begin], &sheepZ[begin], &sheepR[begin],
+                            end - begin, &sheepVisible[begin]);
+    });
+
+    sheepDrawCount = uploadSheep(sheepInstanceBuffer, sheepVisible);
+    cullStats.visibleSheep = sheepDrawCount;
+    cullStats.culledSheep = count - sheepDrawCount;
+}
+
+GLsizei Renderer::uploadSheep(GLuint buffer, const std::vector<uint8_t> &visible) {
+    // Where each visible sheep's record goes in the instance buffer.
+    int count = (int)sheepRoot.size();
+    sheepOffset.resize(count);
+    int visibleSheep = 0;
+    for(int i = 0; i < count; i++) {
+        sheepOffset[i] = visibleSheep;
+        visibleSheep += visible[i];
+    }
+
+    // Orphan the old buffer rather than wait for the GPU to finish with
+    // it, then write the visible sheep straight in.
+    size_t bytes = visibleSheep * sizeof(SheepInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    if(visibleSheep == 0) {
+        return 0;
+    }
+    SheepInstance *out = (SheepInstance *)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(!out) {
+        return 0;
+    }
+    // The mapping is plain memory, so the workers can fill it in while
+    // this thread keeps the GL calls to itself.
+    JobSystem::instance().parallelFor(count, 2048, [&](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            if(visible[i]) {
+                // Only ever written, the mapping may be slow to read back.
+                const mat4 &model = sheepNodes.world(sheepRoot[i]);
+                float scale2;
+                float normalScale = uniformScale(model, scale2) ? 1 / scale2 : 0;
+                SheepInstance &sheep = out[sheepOffset[i]];
+                sheep.model = model;
+                sheep.look = sheepLook[i];
+                sheep.gait = vec4(flock.gaitPhase(i), flock.pace(i), flock.graze(i), normalScale);
+            }
+        }
+    });
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    return visibleSheep;
+}
+
+void Renderer::renderSheep() {
+    if(sheepDrawCount == 0)
+        return;
+    renderQueue.submit(sheepPass, sheepProg, sheepVao, 0, &sheepMaterial, mat4(1.0), mat3(1.0), 0,
+                       GL_TRIANGLE_FAN, sheepMesh.indexCount, sheepDrawCount);
+}
+
+GLuint Renderer::loadShaders(const char* vertf, const char* fragf) {
+    return resources.program(vertf, fragf);
+}
+
@@ -0,0 +1,390 @@
+#ifndef __RENDERER__INCLUDE__
+#define __RENDERER__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "chunkstreamer.h"
+#include "flock.h"
+#include "grass.h"
+#include "heightfield.h"
+#include "hierarchy.h"
+#include "impostors.h"
+#include "meshlod.h"
+#include "particles.h"
+#include "profiler.h"
+#include "renderqueue.h"
+#include "resourcemanager.h"
+#include "scene.h"
+#include "terrain.h"
+
+using glm::mat3;
+using glm::mat4;
+using glm::vec3;
+using glm::vec2;
+using glm::vec4;
+
+// Mirrors the std140 Camera uniform block declared in the shaders.
+struct CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPos;
+    vec4 lightPos;
+};
+
+// Mirrors the std140 Shadows uniform block in cube_frag.glsl.
+struct ShadowBlock {
+    // World to shadow map coordinates, per cascade.
+    mat4 cascades[4];
+    // World size of a shadow map texel, per cascade.
+    vec4 texels;
+    // x is the number of cascades, 0 for no shadows.
+    vec4 params;
+};
+
+// What gets drawn when. Each pass is timed as its own profiler scope.
+enum RenderPass {
+    sheepPass,
+    groundPass,
+    grassPass,
+    treePass,
+    waterPass,
+    moonPass,
+    passCount
+};
+
+// Something in the scene that never moves. Placed once, then found
+// through the static BVH whenever it's in view.
+struct SceneObject {
+    RenderPass pass;
+    const Material *material;
+    mat4 transform;
+    // normalMatrix(transform), worked out once when it's placed.
+    mat3 normal;
+    Aabb bounds;
+};
+
+// Owns all of the GL state for the scene and draws it into whatever
+// framebuffer is bound. It only needs a current 3.3 core context, so the
+// same scene can be drawn by GLWidget or by the headless benchmark.
+class Renderer : protected QOpenGLFunctions_3_3_Core {
+    public:
+        struct CullStats {
+            int visibleObjects;
+            int culledObjects;
+            int visibleSheep;
+            int culledSheep;
+            int nodesTested;
+        };
+
+        Renderer();
+
+        // Scene file to load in initialize, sheep.scene by default.
+        void setScenePath(const QString &path) { scenePath = path; }
+
+        // These need the GL context to be current.
+        void initialize();
+        void resize(int w, int h);
+        void render();
+
+        void setCamera(const mat4 &view, vec3 position);
+
+        // Moves the sheep on by one simulation step. Doesn't touch GL.
+        void simulate(float dt);
+
+        bool stressMode() const { return stress; }
+        void setStressMode(bool enabled);
+
+        // Shadow cascades (0 to 4, 0 turns shadows off) and the size of
+        // each one's map. The defaults are used by every renderer made
+        // after they're set; setShadows takes effect from the next frame.
+        static void setDefaultShadows(int cascades, int size);
+        void setShadows(int cascades, int size);
+
+        // How many particles, and whether to move them on the CPU instead
+        // of the GPU. Used by every renderer initialized after it's set.
+        static void setDefaultParticles(int count, bool cpu);
+
+        // Has the shaders invert every model matrix per vertex for normals,
+        // as they used to, instead of using the ones worked out on the CPU.
+        // For benchmarking; needs the GL context to be current.
+        void setInverseNormals(bool enabled);
+
+        const RenderQueue::Stats &queueStats() const { return renderQueue.stats(); }
+        const CullStats &cullingStats() const { return cullStats; }
+        void printQueueStats() const;
+        const ResourceManager::Stats &resourceStats() const { return resources.stats(); }
+        // The ground's height anywhere, once initialize has loaded the
+        // scene.
+        const Heightfield &ground() const { return heightfield; }
+        Profiler &profiler() { return prof; }
+
+        GLuint loadShaders(const char* vertf, const char* fragf);
+
+    private:
+        void initializeCube();
+        void initializeGround();
+        void initializeTree();
+        void initializeTop();
+        void initializeWater();
+        void initializeStar();
+        void initializeScene();
+        void addStatic(RenderPass pass, const Material &material, mat4 transform);
+        void renderBox(const SceneObject &object);
+
+        // Works out what's in view, once per camera or flock change.
+        void cull();
+        void cullSheep(const Frustum &frustum);
+        // Writes a SheepInstance for every sheep with visible set into
+        // buffer, and returns how many.
+        GLsizei uploadSheep(GLuint buffer, const std::vector<uint8_t> &visible);
+        float viewDepth(const mat4 &transform);
+
+        // Sheep are drawn instanced: addSheep adds a node per sheep to
+        // sheepNodes, cullSheep writes a SheepInstance per visible sheep
+        // into the instance buffer and renderSheep draws those with a
+        // single glDrawElementsInstanced call. The vertex shader poses
+        // the legs, heads and body from the record.
+        void initializeSheep();
+        GLuint sheepVertexArray(GLuint instanceBuffer);
+        void buildFlock();
+        void updateSheep();
+        void updateSheepBounds();
+        void addSheep(mat4 transform, int x, int y, double h, float s, float up, double fat);
+        void initializeFlock();
+        // Root matrix of sheep i where the flock has it.
+        mat4 sheepPlacement(int i) const;
+        void renderSheep();
+
+        // The lake is a mirror: cullReflection mirrors the camera in the
+        // lake's surface and works out what it sees, renderReflection
+        // draws that into reflectionFbo and the water samples it. Only
+        // the trees, the moon and the sheep near the shore are drawn,
+        // only within the lake's rectangle on screen, at between a
+        // quarter and a half of the screen's resolution depending on
+        // how much of the screen the lake fills. If the lake's surface
+        // isn't in view there's no reflection pass at all.
+        void initializeReflection();
+        void resizeReflection();
+        void cullReflection();
+        void renderReflection();
+
+        // Cascaded shadow maps for the moonlight. Each cascade is fitted
+        // around its slice of the view with room to spare, and its
+        // ground and trees are drawn into shadowCache only when the view
+        // wanders out of that room or the light moves. Every frame that
+        // anything moved, each cascade's cached depth is copied into
+        // shadowMap and the sheep are drawn on top.
+        void initializeShadows();
+        void allocateShadows();
+        void cullShadows();
+        void renderShadows();
+
+        // The pasture past the scene's edge, streamed in around the camera
+        // (see chunkstreamer.h) and drawn with the ground and trees.
+        void initializeChunks();
+        void renderChunks();
+
+        ChunkStreamer chunks;
+        GLuint chunkProg;
+        std::vector<int> visibleChunks;
+        // Chunk trees far enough out are drawn as impostors as well or
+        // instead, all in one draw; picked along with visibleChunks.
+        Impostors impostors;
+        std::vector<vec3> farTrees;
+
+        // The ground, everywhere, raised to fit the scene's ground slabs
+        // and drawn with level of detail; see terrain.h.
+        Heightfield heightfield;
+        Terrain terrain;
+        std::vector<Aabb> groundSlabs;
+
+        // Grass on all of it but the lake; see grass.h. windTime is how
+        // long simulate has run, which the blades sway by.
+        void initializeGrass();
+        void renderGrass();
+
+        Grass grass;
+        Material grassMaterial;
+        float windTime;
+
+        // Rocks strewn over the meadow, one made up mesh simplified into
+        // levels of detail (see meshlod.h). Each rock's level is picked in
+        // cull by how big its error would look on screen.
+        struct Rock {
+            mat4 transform;
+            mat3 normal;
+            vec3 center;
+            float scale;
+            int lod;
+        };
+        void initializeRocks();
+        void placeRocks();
+        void renderRocks();
+
+        LodMesh rockMesh;
+        Material rockMaterial;
+        std::vector<Rock> rocks;
+        std::vector<int> visibleRocks;
+
+        // Fireflies, mist and leaves, placed around whatever the scene
+        // has for a meadow, a lake and tree tops. They're moved on by the
+        // time simulate has been given since the last frame, at the start
+        // of drawing them; simulate never touches GL.
+        void placeParticles();
+        void renderParticles();
+
+        ParticleSystem particles;
+        float particleTime;
+
+        // All of the boxes share one cube mesh and program; what they look
+        // like is down to their material.
+        GLuint cubeProg;
+        Mesh cubeMesh;
+        GLuint textureObject;
+        // The cube program with a mirror on top, for the lake.
+        GLuint waterProg;
+
+        // What goes up to the GPU per sheep, at lookAttrib and gaitAttrib
+        // after the model matrix.
+        struct SheepInstance {
+            mat4 model;
+            // Head turn and nod in 45ths of a radian, fatness, heads.
+            vec4 look;
+            // Walk cycle phase, pace and graze, as the flock has them,
+            // then 1 / scale^2 of model if it scales evenly, which lets the
+            // shader skip inverting it for normals, or 0 if it doesn't.
+            vec4 gait;
+        };
+
+        GLuint sheepProg;
+        GLuint sheepVao;
+        Mesh sheepMesh;
+        // The part each vertex of sheepMesh belongs to.
+        GLuint sheepPartBuffer;
+        GLuint sheepInstanceBuffer;
+        TransformHierarchy sheepNodes;
+        // Moves the sheep's root nodes around; sheep i is sheepRoot[i].
+        Flock flock;
+        std::vector<int> sheepRoot;
+        std::vector<vec4> sheepLook;
+        // One bounding sphere per sheep, as separate arrays so the
+        // frustum can test four at a time.
+        std::vector<float> sheepX;
+        std::vector<float> sheepY;
+        std::vector<float> sheepZ;
+        std::vector<float> sheepR;
+        std::vector<uint8_t> sheepVisible;
+        // Each visible sheep's instance.
+        std::vector<int> sheepOffset;
+        GLsizei sheepDrawCount;
+        bool sheepDirty;
+        bool stress;
+
+        Material sheepMaterial;
+        Material groundMaterial;
+        Material treeMaterial;
+        Material topMaterial;
+        Material waterMaterial;
+        Material starMaterial;
+
+        void initializeGrid();
+        void renderGrid();
+
+        GLuint gridProg;
+        GLuint gridVao;
+        GLint gridModelMatrixLoc;
+
+        QString scenePath;
+        Scene scene;
+        Scene stressScene;
+
+        std::vector<SceneObject> statics;
+        Bvh staticBvh;
+        std::vector<int> visibleStatics;
+        bool cullDirty;
+        CullStats cullStats;
+
+        // Every render* call submits here; render flushes it once per frame.
+        RenderQueue renderQueue;
+
+        ResourceManager resources;
+        Profiler prof;
+
+        GLuint cameraUbo;
+        bool cameraDirty;
+
+        GLuint reflectionFbo;
+        GLuint reflectionTexture;
+        GLuint reflectionDepth;
+        // Size of the textures, half the screen's; a frame's reflection
+        // only uses reflectionScale of the screen's size of it.
+        int reflectionWidth;
+        int reflectionHeight;
+        float reflectionScale;
+        // The lake's surface on screen, in reflection texture pixels.
+        int reflectionRect[4];
+        bool reflecting;
+        // The mirrored camera.
+        GLuint reflectionCameraUbo;
+        RenderQueue reflectionQueue;
+        std::vector<int> reflectionStatics;
+        std::vector<uint8_t> reflectionSheepVisible;
+        GLuint reflectionSheepBuffer;
+        GLuint reflectionSheepVao;
+        GLsizei reflectionSheepCount;
+
+        static const int maxCascades = 4;
+        struct Cascade {
+            // Centre and half size of the square it covers, in light
+            // space, and the depth range along the light.
+            vec2 center;
+            float halfSize;
+            float nearZ;
+            float farZ;
+            // Its ground and trees need drawing into shadowCache again.
+            bool staticDirty;
+            GLuint cameraUbo;
+            std::vector<int> statics;
+            std::vector<uint8_t> sheepVisible;
+            GLuint sheepBuffer;
+            GLuint sheepVao;
+            GLsizei sheepCount;
+        };
+        int shadowCascades;
+        int shadowSize;
+        // shadowCascades and shadowSize changed since they were allocated.
+        bool shadowsChanged;
+        // Something moved since the shadow maps were last drawn.
+        bool shadowsStale;
+        Cascade cascades[maxCascades];
+        // Depth, one layer per cascade: what's drawn from, and the cache
+        // of the ground and trees.
+        GLuint shadowMap;
+        GLuint shadowCache;
+        GLuint shadowFbo;
+        GLuint shadowCacheFbo;
+        GLuint shadowUbo;
+        GLuint cubeShadowProg;
+        GLuint sheepShadowProg;
+        RenderQueue shadowQueue;
+        mat4 lightView;
+        vec3 shadowLight;
+        // Everything that casts a shadow is in here.
+        Aabb casterBounds;
+        void uploadCamera();
+
+        mat4 projMatrix;
+        mat4 viewMatrix;
+        mat4 modelMatrix;
+        vec3 ltPos;
+        vec3 cameraPosition;
+
+        int width;
+        int height;
+};
+
+#endif
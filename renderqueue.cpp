@@ -0,0 +1,224 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+using glm::value_ptr;
+
+// Draws further than this all share the farthest depth bucket; nothing
+// past the far plane is drawn anyway.
+static const float maxDepth = farPlane;
+
+static bool keyLess(const DrawCommand &a, const DrawCommand &b) {
+    return a.key < b.key;
+}
+
+// Whatever was bound before a frame is unknown, so the tracker starts
+// from a name that can't match and forces the first bind of each kind.
+static const GLuint unknown = 0xFFFFFFFF;
+
+static void resetStats(RenderQueue::Stats &stats) {
+    stats.draws = 0;
+    stats.programChanges = 0;
+    stats.vaoChanges = 0;
+    stats.textureChanges = 0;
+    stats.materialChanges = 0;
+    stats.savedChanges = 0;
+}
+
+bool uniformScale(const mat4 &model, float &scale2) {
+    vec3 x(model[0]), y(model[1]), z(model[2]);
+    float xx = glm::dot(x, x);
+    float yy = glm::dot(y, y);
+    float zz = glm::dot(z, z);
+    // Columns the same length and at right angles, give or take rounding.
+    float slack = 1e-4f * xx;
+    if(xx <= 0 || fabsf(xx - yy) > slack || fabsf(xx - zz) > slack ||
+       fabsf(glm::dot(x, y)) > slack || fabsf(glm::dot(x, z)) > slack ||
+       fabsf(glm::dot(y, z)) > slack) {
+        return false;
+    }
+    scale2 = xx;
+    return true;
+}
+
+mat3 normalMatrix(const mat4 &model) {
+    // A rotation is its own inverse transpose, so an evenly scaled one is
+    // itself over the scale squared.
+    float scale2;
+    if(uniformScale(model, scale2)) {
+        return mat3(model) * (1 / scale2);
+    }
+    return glm::transpose(glm::inverse(mat3(model)));
+}
+
+RenderQueue::RenderQueue() {
+    resetStats(lastStats);
+    clear();
+}
+
+uint64_t RenderQueue::makeKey(int pass, GLuint program, GLuint vao, GLuint texture,
+                             const Material *material, float depth) {
+    // 4 bits of pass, then 10 bits of program and VAO name and 8 of
+    // texture name and material, most expensive state change first, then
+    // 24 bits of depth so that draws sharing all their state go front to
+    // back.
+    if(depth < 0) {
+        depth = 0;
+    } else if(depth > maxDepth) {
+        depth = maxDepth;
+    }
+    uint64_t d = (uint64_t)(depth / maxDepth * ((1 << 24) - 1));
+    uint64_t m = material ? material->id : 0;
+
+    return ((uint64_t)(pass & 0xF) << 60) |
+           ((uint64_t)(program & 0x3FF) << 50) |
+           ((uint64_t)(vao & 0x3FF) << 40) |
+           ((uint64_t)(texture & 0xFF) << 32) |
+           ((m & 0xFF) << 24) |
+           d;
+}
+
+const RenderQueue::UniformLocations &RenderQueue::locationsFor(QOpenGLFunctions_3_3_Core *gl,
+                                                               GLuint program) {
+    std::map<GLuint, UniformLocations>::iterator it = locations.find(program);
+    if(it != locations.end()) {
+        return it->second;
+    }
+
+    UniformLocations locs;
+    locs.model = gl->glGetUniformLocation(program, "model");
+    locs.normalMatrix = gl->glGetUniformLocation(program, "normalMatrix");
+    locs.shape = gl->glGetUniformLocation(program, "shape");
+    locs.topColor = gl->glGetUniformLocation(program, "topColor");
+    locs.sideColor = gl->glGetUniformLocation(program, "sideColor");
+    locs.bottomColor = gl->glGetUniformLocation(program, "bottomColor");
+    locs.ambient = gl->glGetUniformLocation(program, "ambient");
+    locs.shininess = gl->glGetUniformLocation(program, "shininess");
+    locs.speck = gl->glGetUniformLocation(program, "speck");
+    return locations[program] = locs;
+}
+
+void RenderQueue::uploadMaterial(QOpenGLFunctions_3_3_Core *gl, const UniformLocations &locs,
+                                 const Material *material) {
+    gl->glUniformMatrix4fv(locs.shape, 1, false, value_ptr(material->shape));
+    gl->glUniform3fv(locs.topColor, 1, value_ptr(material->topColor));
+    gl->glUniform3fv(locs.sideColor, 1, value_ptr(material->sideColor));
+    gl->glUniform3fv(locs.bottomColor, 1, value_ptr(material->bottomColor));
+    gl->glUniform1f(locs.ambient, material->ambient);
+    gl->glUniform1f(locs.shininess, material->shininess);
+    gl->glUniform1f(locs.speck, material->speck);
+}
+
+void RenderQueue::clear() {
+    commands.clear();
+
+    currentProgram = unknown;
+    currentVao = unknown;
+    currentTexture = unknown;
+    currentMaterial = NULL;
+
+    resetStats(frameStats);
+    naiveChanges = 0;
+}
+
+void RenderQueue::submit(int pass, GLuint program, GLuint vao, GLuint texture,
+                         const Material *material, const mat4 &model, const mat3 &normal, float depth,
+                         GLenum mode, GLsizei count, GLsizei instances,
+                         GLsizei firstIndex, GLint baseVertex) {
+    DrawCommand cmd;
+    cmd.key = makeKey(pass, program, vao, texture, material, depth);
+    cmd.pass = pass;
+    cmd.program = program;
+    cmd.vao = vao;
+    cmd.texture = texture;
+    cmd.material = material;
+    cmd.model = model;
+    cmd.normal = normal;
+    cmd.mode = mode;
+    cmd.count = count;
+    cmd.instances = instances;
+    cmd.firstIndex = firstIndex;
+    cmd.baseVertex = baseVertex;
+    commands.push_back(cmd);
+}
+
+void RenderQueue::sort() {
+    // stable_sort keeps submission order for draws with identical keys.
+    std::stable_sort(commands.begin(), commands.end(), keyLess);
+}
+
+void RenderQueue::flush(QOpenGLFunctions_3_3_Core *gl, int pass) {
+    // The pass is the top of the key, so after sorting each pass is one
+    // contiguous run of commands.
+    DrawCommand first;
+    first.key = (uint64_t)pass << 60;
+    std::vector<DrawCommand>::iterator it =
+        std::lower_bound(commands.begin(), commands.end(), first, keyLess);
+
+    Stats &stats = frameStats;
+    for(; it != commands.end() && it->pass == pass; ++it) {
+        const DrawCommand &cmd = *it;
+
+        naiveChanges += 2;
+        if(cmd.program != currentProgram) {
+            gl->glUseProgram(cmd.program);
+            currentProgram = cmd.program;
+            // Uniforms belong to the program, so a new program needs the
+            // material uploaded again.
+            currentMaterial = NULL;
+            stats.programChanges++;
+        }
+        const UniformLocations &locs = locationsFor(gl, cmd.program);
+        if(cmd.vao != currentVao) {
+            gl->glBindVertexArray(cmd.vao);
+            currentVao = cmd.vao;
+            stats.vaoChanges++;
+        }
+        if(cmd.texture != 0) {
+            naiveChanges++;
+            if(cmd.texture != currentTexture) {
+                gl->glBindTexture(GL_TEXTURE_2D, cmd.texture);
+                currentTexture = cmd.texture;
+                stats.textureChanges++;
+            }
+        }
+
+        if(cmd.material && cmd.material != currentMaterial) {
+            uploadMaterial(gl, locs, cmd.material);
+            currentMaterial = cmd.material;
+            stats.materialChanges++;
+        }
+
+        if(locs.model >= 0) {
+            gl->glUniformMatrix4fv(locs.model, 1, false, value_ptr(cmd.model));
+        }
+        if(locs.normalMatrix >= 0) {
+            gl->glUniformMatrix3fv(locs.normalMatrix, 1, false, value_ptr(cmd.normal));
+        }
+
+        const void *indices = (const void *)(sizeof(GLuint) * cmd.firstIndex);
+        if(cmd.baseVertex != 0) {
+            if(cmd.instances == 1) {
+                gl->glDrawElementsBaseVertex(cmd.mode, cmd.count, GL_UNSIGNED_INT, (void *)indices,
+                                             cmd.baseVertex);
+            } else {
+                gl->glDrawElementsInstancedBaseVertex(cmd.mode, cmd.count, GL_UNSIGNED_INT, (void *)indices,
+                                                      cmd.instances, cmd.baseVertex);
+            }
+        } else if(cmd.instances == 1) {
+            gl->glDrawElements(cmd.mode, cmd.count, GL_UNSIGNED_INT, indices);
+        } else {
+            gl->glDrawElementsInstanced(cmd.mode, cmd.count, GL_UNSIGNED_INT, indices, cmd.instances);
+        }
+        stats.draws++;
+    }
+}
+
+void RenderQueue::finish() {
+    frameStats.savedChanges = naiveChanges - frameStats.programChanges -
+                              frameStats.vaoChanges - frameStats.textureChanges;
+    lastStats = frameStats;
+    commands.clear();
+}
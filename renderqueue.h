@@ -0,0 +1,136 @@
+#ifndef __RENDERQUEUE__INCLUDE__
+#define __RENDERQUEUE__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+using glm::mat3;
+using glm::mat4;
+using glm::vec3;
+
+// Far plane of the camera's projection. The queue's depth keys cover
+// everything from the eye out to here, so it's shared rather than copied.
+const float farPlane = 100.0f;
+
+// The matrix that takes normals along with model: the inverse transpose
+// of its upper 3x3. Matrices that only rotate, translate and scale evenly,
+// which is nearly all of them, skip the inverse.
+mat3 normalMatrix(const mat4 &model);
+// Whether model only rotates, translates and scales evenly, and if so the
+// square of that scale.
+bool uniformScale(const mat4 &model, float &scale2);
+
+// Per-object surface data. Every cube-shaped object shares one mesh and
+// one program, and the material is all that tells them apart.
+struct Material {
+    // Small unique number, part of the sort key.
+    int id;
+    // Fits the shared unit cube to the object's box. Kept apart from the
+    // model matrix so normals are transformed as before.
+    mat4 shape;
+    vec3 topColor;
+    vec3 sideColor;
+    vec3 bottomColor;
+    float ambient;
+    float shininess;
+    float speck;
+};
+
+// A single draw submitted to the render queue. Everything needed to issue
+// the draw is captured up front so the queue can reorder submissions.
+struct DrawCommand {
+    uint64_t key;
+    int pass;
+    GLuint program;
+    GLuint vao;
+    GLuint texture;
+    const Material *material;
+    mat4 model;
+    mat3 normal;
+    GLenum mode;
+    GLsizei count;
+    GLsizei instances;
+    // Where in the VAO's index buffer the draw starts, and what's added to
+    // every index, for meshes packed several to a buffer.
+    GLsizei firstIndex;
+    GLint baseVertex;
+};
+
+// Collects a frame's draws, sorts them by (pass, program, VAO, texture,
+// material, depth) and issues them while skipping binds of state that is
+// already current.
+//
+// A frame goes clear, submit..., sort, then flush once per pass so the
+// caller can wrap each pass (in a profiler scope, say), then finish.
+class RenderQueue {
+    public:
+        struct Stats {
+            int draws;
+            int programChanges;
+            int vaoChanges;
+            int textureChanges;
+            int materialChanges;
+            // Binds an unsorted, untracked renderer would have issued
+            // that the state tracker skipped.
+            int savedChanges;
+        };
+
+        RenderQueue();
+
+        // Up to 16 passes, drawn in increasing order.
+        static const int maxPasses = 16;
+
+        void clear();
+        // A texture of 0 means the draw doesn't care what is bound. Programs
+        // without a model uniform (the instanced ones) ignore the model and
+        // normal matrices; normal is normalMatrix(model), worked out by the
+        // caller so objects that don't move only do it once. firstIndex and
+        // baseVertex pick one mesh out of several packed into the VAO's
+        // buffers (see meshlod.h).
+        void submit(int pass, GLuint program, GLuint vao, GLuint texture, const Material *material,
+                    const mat4 &model, const mat3 &normal, float depth,
+                    GLenum mode, GLsizei count, GLsizei instances = 1,
+                    GLsizei firstIndex = 0, GLint baseVertex = 0);
+        void sort();
+        void flush(QOpenGLFunctions_3_3_Core *gl, int pass);
+        void finish();
+
+        const Stats &stats() const { return lastStats; }
+
+    private:
+        struct UniformLocations {
+            GLint model;
+            GLint normalMatrix;
+            GLint shape;
+            GLint topColor;
+            GLint sideColor;
+            GLint bottomColor;
+            GLint ambient;
+            GLint shininess;
+            GLint speck;
+        };
+
+        static uint64_t makeKey(int pass, GLuint program, GLuint vao, GLuint texture,
+                                const Material *material, float depth);
+        const UniformLocations &locationsFor(QOpenGLFunctions_3_3_Core *gl, GLuint program);
+        void uploadMaterial(QOpenGLFunctions_3_3_Core *gl, const UniformLocations &locs,
+                            const Material *material);
+
+        std::vector<DrawCommand> commands;
+        std::map<GLuint, UniformLocations> locations;
+
+        // State tracker, carried across the passes of one frame.
+        GLuint currentProgram;
+        GLuint currentVao;
+        GLuint currentTexture;
+        const Material *currentMaterial;
+
+        Stats frameStats;
+        int naiveChanges;
+        Stats lastStats;
+};
+
+#endif
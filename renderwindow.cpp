@@ -0,0 +1,169 @@
+#include "renderwindow.h"
+#include "cameracontroller.h"
+#include "renderer.h"
+#include "simclock.h"
+
+#include <iostream>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+RenderThread::RenderThread(QWindow *w, InputRing *ring, const QString &path)
+    : window(w), input(ring), scenePath(path) {
+    running.store(true);
+    visible.store(false);
+}
+
+void RenderThread::run() {
+    QOpenGLContext context;
+    context.setFormat(window->requestedFormat());
+    if(!context.create() || !context.makeCurrent(window)) {
+        std::cerr << "Could not create a GL 3.3 core context for the render thread" << std::endl;
+        return;
+    }
+    QOpenGLFunctions *gl = context.functions();
+
+    Renderer renderer;
+    renderer.setScenePath(scenePath);
+    renderer.initialize();
+    Profiler &prof = renderer.profiler();
+
+    CameraController camera;
+    camera.setGround(&renderer.ground());
+    SimClock clock;
+    clock.start();
+
+    int width = 0;
+    int height = 0;
+
+    while(running.load()) {
+        if(!visible.load()) {
+            // Nothing to draw into while minimized or covered up.
+            msleep(16);
+            continue;
+        }
+
+        prof.beginCpu("input");
+        InputEvent event;
+        while(input->pop(event)) {
+            switch(event.type) {
+                case InputEvent::KeyPress:
+                    if(camera.keyPressed(event.key)) {
+                        break;
+                    }
+                    if(event.key == Qt::Key_P) {
+                        // toggle the 50k sheep stress test
+                        renderer.setStressMode(!renderer.stressMode());
+                    } else if(event.key == Qt::Key_I) {
+                        // print render queue stats for the last frame
+                        renderer.printQueueStats();
+                    } else if(event.key == Qt::Key_F3) {
+                        // No QPainter overlay on this thread, print the
+                        // timings instead.
+                        const std::vector<Profiler::Scope> &scopes = prof.scopes();
+                        for(size_t i = 0; i < scopes.size(); i++) {
+                            std::cout << (scopes[i].gpu ? "gpu " : "cpu ") << scopes[i].name
+                                      << " " << scopes[i].ms << " ms" << std::endl;
+                        }
+                    } else if(event.key == Qt::Key_F4) {
+                        // dump the recorded profiler scopes for chrome://tracing
+                        if(prof.writeChromeTrace("trace.json")) {
+                            std::cout << "Wrote trace.json" << std::endl;
+                        }
+                    }
+                    break;
+                case InputEvent::KeyRelease:
+                    camera.keyReleased(event.key);
+                    break;
+                case InputEvent::MousePress:
+                    camera.mousePressed(vec2(event.x, event.y));
+                    break;
+                case InputEvent::MouseMove:
+                    camera.mouseMoved(vec2(event.x, event.y));
+                    break;
+                case InputEvent::Resize:
+                    width = event.x;
+                    height = event.y;
+                    renderer.resize(width, height);
+                    break;
+            }
+        }
+        prof.endCpu();
+
+        prof.beginCpu("animate");
+        int steps = clock.advance();
+        for(int i = 0; i < steps; i++) {
+            camera.step(clock.step());
+            renderer.simulate(clock.step());
+        }
+        float alpha = clock.alpha();
+        renderer.setCamera(camera.view(alpha), camera.eye(alpha));
+        prof.endCpu();
+
+        if(width > 0 && height > 0) {
+            gl->glViewport(0, 0, width, height);
+            renderer.render();
+        }
+        // Blocks on vsync, which paces the loop (unless --uncapped).
+        context.swapBuffers(window);
+    }
+
+    context.doneCurrent();
+}
+
+RenderWindow::RenderWindow(const QString &scenePath) : thread(this, &input, scenePath) {
+    setSurfaceType(QWindow::OpenGLSurface);
+    setTitle("Sheep Planet");
+}
+
+RenderWindow::~RenderWindow() {
+    thread.stop();
+    thread.wait();
+}
+
+void RenderWindow::exposeEvent(QExposeEvent *) {
+    thread.setExposed(isExposed());
+    if(isExposed() && !thread.isRunning()) {
+        queueResize();
+        thread.start();
+    }
+}
+
+void RenderWindow::resizeEvent(QResizeEvent *) {
+    queueResize();
+}
+
+void RenderWindow::queueResize() {
+    qreal ratio = devicePixelRatio();
+    queue(InputEvent::Resize, 0, (int)(width() * ratio), (int)(height() * ratio));
+}
+
+void RenderWindow::mousePressEvent(QMouseEvent *event) {
+    queue(InputEvent::MousePress, 0, event->x(), event->y());
+}
+
+void RenderWindow::mouseMoveEvent(QMouseEvent *event) {
+    queue(InputEvent::MouseMove, 0, event->x(), event->y());
+}
+
+void RenderWindow::keyPressEvent(QKeyEvent *event) {
+    if(!event->isAutoRepeat()) {
+        queue(InputEvent::KeyPress, event->key(), 0, 0);
+    }
+}
+
+void RenderWindow::keyReleaseEvent(QKeyEvent *event) {
+    if(!event->isAutoRepeat()) {
+        queue(InputEvent::KeyRelease, event->key(), 0, 0);
+    }
+}
+
+void RenderWindow::queue(InputEvent::Type type, int key, int x, int y) {
+    InputEvent event;
+    event.type = type;
+    event.key = key;
+    event.x = x;
+    event.y = y;
+    input.push(event);
+}
@@ -0,0 +1,57 @@
+#ifndef __RENDERWINDOW__INCLUDE__
+#define __RENDERWINDOW__INCLUDE__
+
+#include <QThread>
+#include <QWindow>
+#include <atomic>
+
+#include "inputring.h"
+
+// Draws the scene on its own thread with its own context. Everything GL,
+// the camera and the simulation clock live on this thread; the only
+// thing shared with the GUI is the input ring and a few flags.
+class RenderThread : public QThread {
+    public:
+        RenderThread(QWindow *window, InputRing *input, const QString &scenePath);
+
+        void setExposed(bool exposed) { visible.store(exposed); }
+        // Asks the loop to finish its frame and exit; wait() for it.
+        void stop() { running.store(false); }
+
+    protected:
+        void run();
+
+    private:
+        QWindow *window;
+        InputRing *input;
+        QString scenePath;
+        std::atomic<bool> running;
+        std::atomic<bool> visible;
+};
+
+// Plain QWindow front end for RenderThread (see --render-thread). Its
+// event handlers only turn Qt events into InputEvents and push them onto
+// the ring, so however heavy the mouse motion the GUI thread never waits
+// on the GPU driver, and the render thread paces frames by itself.
+class RenderWindow : public QWindow {
+    public:
+        RenderWindow(const QString &scenePath);
+        ~RenderWindow();
+
+    protected:
+        void exposeEvent(QExposeEvent *event);
+        void resizeEvent(QResizeEvent *event);
+        void mousePressEvent(QMouseEvent *event);
+        void mouseMoveEvent(QMouseEvent *event);
+        void keyPressEvent(QKeyEvent *event);
+        void keyReleaseEvent(QKeyEvent *event);
+
+    private:
+        void queue(InputEvent::Type type, int key, int x, int y);
+        void queueResize();
+
+        InputRing input;
+        RenderThread thread;
+};
+
+#endif
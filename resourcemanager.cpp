@@ -0,0 +1,359 @@
+#include "resourcemanager.h"
+
+#include <iostream>
+#include <string.h>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+
+// Header written in front of every cached program binary.
+struct BinaryHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+    uint32_t length;
+    uint32_t padding;
+};
+
+static const uint32_t binaryMagic = 0x42535053; // "SPSB"
+
+// Bound by name before every link. They go into the program key too: a
+// binary linked with different locations would still load fine, and then
+// read every attribute from the wrong place.
+struct AttribBinding {
+    GLuint location;
+    const char *name;
+};
+
+static const AttribBinding attribBindings[] = {
+    { positionAttrib, "position" },
+    { normalAttrib, "normal" },
+    { colorAttrib, "color" },
+    { modelAttrib, "model" },
+    { lookAttrib, "look" },
+    { gaitAttrib, "gait" },
+    { partAttrib, "part" },
+    { velocityAttrib, "velocity" },
+    { nodeAttrib, "node" },
+    { bladeAttrib, "blade" },
+    { treeAttrib, "tree" }
+};
+
+static const int attribBindingCount = sizeof(attribBindings) / sizeof(attribBindings[0]);
+
+ResourceManager::ResourceManager() {
+    gl = NULL;
+    extra = NULL;
+    binarySupported = false;
+    driverHash = 0;
+    counts.programRequests = 0;
+    counts.programsCreated = 0;
+    counts.programsFromBinary = 0;
+    counts.programNanos = 0;
+    counts.meshRequests = 0;
+    counts.meshesCreated = 0;
+    counts.bufferBytes = 0;
+}
+
+void ResourceManager::initialize(QOpenGLFunctions_3_3_Core *functions) {
+    gl = functions;
+
+    // glProgramBinary isn't part of 3.3 core, so it comes through the
+    // context's extra functions, and only if the driver offers at least
+    // one binary format.
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    extra = context->extraFunctions();
+    GLint formats = 0;
+    if(context->hasExtension("GL_ARB_get_program_binary")) {
+        gl->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    binarySupported = formats > 0;
+
+    const char *strings[] = {
+        (const char *)gl->glGetString(GL_VENDOR),
+        (const char *)gl->glGetString(GL_RENDERER),
+        (const char *)gl->glGetString(GL_VERSION)
+    };
+    driverHash = hash(NULL, 0);
+    for(int i = 0; i < 3; i++) {
+        if(strings[i]) {
+            driverHash = hash(strings[i], strlen(strings[i]), driverHash);
+        }
+    }
+
+    cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+    if(binarySupported && !QDir().mkpath(cacheDir)) {
+        binarySupported = false;
+    }
+}
+
+uint64_t ResourceManager::hash(const void *data, size_t size, uint64_t seed) {
+    // 64-bit FNV-1a
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string ResourceManager::readFile(const char *path) {
+    // read shader source from Qt resource file
+    QFile file(path);
+    file.open(QFile::ReadOnly | QFile::Text);
+    QString string;
+    QTextStream stream(&file);
+    string.append(stream.readAll());
+    return string.toStdString();
+}
+
+GLuint ResourceManager::program(const char *vertf, const char *fragf,
+                                const char *const *feedback, int feedbackCount) {
+    counts.programRequests++;
+
+    std::string vertSource = readFile(vertf);
+    std::string fragSource = readFile(fragf);
+
+    uint64_t key = hash(vertSource.data(), vertSource.size());
+    key = hash(fragSource.data(), fragSource.size(), key);
+    for(int i = 0; i < feedbackCount; i++) {
+        key = hash(feedback[i], strlen(feedback[i]) + 1, key);
+    }
+    for(int i = 0; i < attribBindingCount; i++) {
+        key = hash(&attribBindings[i].location, sizeof(GLuint), key);
+        key = hash(attribBindings[i].name, strlen(attribBindings[i].name) + 1, key);
+    }
+
+    std::map<uint64_t, GLuint>::iterator it = programs.find(key);
+    if(it != programs.end()) {
+        return it->second;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    GLuint program = 0;
+    uint64_t binaryKey = hash(&driverHash, sizeof(driverHash), key);
+    if(binarySupported) {
+        program = loadBinary(binaryKey);
+    }
+    if(program) {
+        counts.programsFromBinary++;
+    } else {
+        program = linkProgram(vertSource, fragSource, feedback, feedbackCount);
+        if(binarySupported) {
+            saveBinary(program, binaryKey);
+        }
+    }
+    // Uniform block bindings aren't part of the binary, so they're set
+    // again either way.
+    bindUniformBlocks(program);
+
+    counts.programNanos += timer.nsecsElapsed();
+
+    programs[key] = program;
+    counts.programsCreated++;
+    return program;
+}
+
+QString ResourceManager::binaryPath(uint64_t key) const {
+    return cacheDir + "/" + QString::number(key, 16) + ".bin";
+}
+
+GLuint ResourceManager::loadBinary(uint64_t key) {
+    QFile file(binaryPath(key));
+    if(!file.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    BinaryHeader header;
+    bool valid = data.size() >= (int)sizeof(header);
+    if(valid) {
+        memcpy(&header, data.constData(), sizeof(header));
+        valid = header.magic == binaryMagic && header.key == key &&
+                header.length == data.size() - sizeof(header);
+    }
+
+    GLuint program = 0;
+    if(valid) {
+        program = gl->glCreateProgram();
+        extra->glProgramBinary(program, header.format,
+                               data.constData() + sizeof(header), header.length);
+
+        // The driver is free to reject a binary, after an update for
+        // instance, in which case we fall back to compiling from source.
+        GLint linked;
+        gl->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if(!linked) {
+            gl->glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    if(!program) {
+        std::cout << "Discarding stale program binary " << binaryPath(key).toStdString() << std::endl;
+        QFile::remove(binaryPath(key));
+    }
+    return program;
+}
+
+void ResourceManager::saveBinary(GLuint program, uint64_t key) {
+    GLint length = 0;
+    gl->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) {
+        return;
+    }
+
+    QByteArray data(int(sizeof(BinaryHeader) + length), '\0');
+    BinaryHeader header;
+    GLenum format = 0;
+    extra->glGetProgramBinary(program, length, &length, &format, data.data() + sizeof(header));
+    header.magic = binaryMagic;
+    header.format = format;
+    header.key = key;
+    header.length = length;
+    header.padding = 0;
+    memcpy(data.data(), &header, sizeof(header));
+
+    // QSaveFile only replaces the old file once everything is written,
+    // so a crash mid-write can't leave a truncated binary behind.
+    QSaveFile file(binaryPath(key));
+    if(file.open(QFile::WriteOnly)) {
+        file.write(data.constData(), sizeof(header) + length);
+        file.commit();
+    }
+}
+
+GLuint ResourceManager::compileShader(GLenum type, const std::string &source) {
+    const GLchar *sourcePtr = source.c_str();
+
+    GLuint shader = gl->glCreateShader(type);
+    gl->glShaderSource(shader, 1, &sourcePtr, NULL);
+    gl->glCompileShader(shader);
+    {
+        GLint compiled;
+        gl->glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+        if ( !compiled ) {
+            GLsizei len;
+            gl->glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &len );
+
+            GLchar* log = new GLchar[len+1];
+            gl->glGetShaderInfoLog( shader, len, &len, log );
+            std::cerr << "Shader compilation failed: " << log << std::endl;
+            delete [] log;
+        }
+    }
+    return shader;
+}
+
+GLuint ResourceManager::linkProgram(const std::string &vertSource, const std::string &fragSource,
+                                    const char *const *feedback, int feedbackCount) {
+    GLuint program = gl->glCreateProgram();
+
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertSource);
+    gl->glAttachShader(program, vertShader);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSource);
+    gl->glAttachShader(program, fragShader);
+
+    for(int i = 0; i < attribBindingCount; i++) {
+        gl->glBindAttribLocation(program, attribBindings[i].location, attribBindings[i].name);
+    }
+
+    if(feedbackCount > 0) {
+        gl->glTransformFeedbackVaryings(program, feedbackCount, feedback, GL_INTERLEAVED_ATTRIBS);
+    }
+
+    // Ask the driver to keep the linked binary around for saveBinary.
+    if(binarySupported) {
+        extra->glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    gl->glLinkProgram(program);
+    {
+        GLint linked;
+        gl->glGetProgramiv( program, GL_LINK_STATUS, &linked );
+        if ( !linked ) {
+            GLsizei len;
+            gl->glGetProgramiv( program, GL_INFO_LOG_LENGTH, &len );
+
+            GLchar* log = new GLchar[len+1];
+            gl->glGetProgramInfoLog( program, len, &len, log );
+            std::cout << "Shader linker failed: " << log << std::endl;
+            delete [] log;
+        }
+    }
+
+    // The program keeps the compiled code, the shader objects themselves
+    // are no longer needed.
+    gl->glDetachShader(program, vertShader);
+    gl->glDeleteShader(vertShader);
+    gl->glDetachShader(program, fragShader);
+    gl->glDeleteShader(fragShader);
+
+    return program;
+}
+
+void ResourceManager::bindUniformBlocks(GLuint program) {
+    // Hook the program's Camera block, if it has one, up to the shared
+    // camera uniform buffer, and likewise its Shadows block.
+    GLuint cameraIndex = gl->glGetUniformBlockIndex(program, "Camera");
+    if(cameraIndex != GL_INVALID_INDEX) {
+        gl->glUniformBlockBinding(program, cameraIndex, cameraBinding);
+    }
+    GLuint shadowIndex = gl->glGetUniformBlockIndex(program, "Shadows");
+    if(shadowIndex != GL_INVALID_INDEX) {
+        gl->glUniformBlockBinding(program, shadowIndex, shadowBinding);
+    }
+}
+
+Mesh ResourceManager::mesh(const vec3 *positions, const vec3 *normals, int vertexCount,
+                           const GLuint *indices, int indexCount) {
+    counts.meshRequests++;
+
+    uint64_t key = hash(positions, sizeof(vec3) * vertexCount);
+    key = hash(normals, sizeof(vec3) * vertexCount, key);
+    key = hash(indices, sizeof(GLuint) * indexCount, key);
+
+    std::map<uint64_t, Mesh>::iterator it = meshes.find(key);
+    if(it != meshes.end()) {
+        return it->second;
+    }
+
+    Mesh mesh;
+    mesh.indexCount = indexCount;
+
+    // Create a new Vertex Array Object on the GPU which
+    // saves the attribute layout of our vertices.
+    gl->glGenVertexArrays(1, &mesh.vao);
+    gl->glBindVertexArray(mesh.vao);
+
+    gl->glGenBuffers(1, &mesh.positionBuffer);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, mesh.positionBuffer);
+    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * vertexCount, positions, GL_STATIC_DRAW);
+    gl->glEnableVertexAttribArray(positionAttrib);
+    gl->glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    gl->glGenBuffers(1, &mesh.normalBuffer);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, mesh.normalBuffer);
+    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * vertexCount, normals, GL_STATIC_DRAW);
+    gl->glEnableVertexAttribArray(normalAttrib);
+    gl->glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    gl->glGenBuffers(1, &mesh.indexBuffer);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexCount, indices, GL_STATIC_DRAW);
+
+    gl->glBindVertexArray(0);
+
+    meshes[key] = mesh;
+    counts.meshesCreated++;
+    counts.bufferBytes += (sizeof(vec3) * 2) * vertexCount + sizeof(GLuint) * indexCount;
+    return mesh;
+}
@@ -0,0 +1,106 @@
+#ifndef __RESOURCEMANAGER__INCLUDE__
+#define __RESOURCEMANAGER__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLExtraFunctions>
+#include <QString>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+using glm::vec3;
+
+// Vertex attributes are bound to the same locations in every program, so
+// a mesh's VAO works with whichever program draws it.
+enum AttributeLocation {
+    positionAttrib = 0,
+    normalAttrib = 1,
+    colorAttrib = 2,
+    // mat4, takes up locations 3 through 6
+    modelAttrib = 3,
+    // Per sheep and per sheep part, see sheep_vert.glsl.
+    lookAttrib = 7,
+    gaitAttrib = 8,
+    partAttrib = 9,
+    // Particles, see particles.h.
+    velocityAttrib = 10,
+    // Per terrain patch, see terrain.h.
+    nodeAttrib = 11,
+    // Per blade of grass, see grass.h.
+    bladeAttrib = 12,
+    // Per far away tree, see impostors.h.
+    treeAttrib = 13
+};
+
+struct Mesh {
+    GLuint vao;
+    GLuint positionBuffer;
+    GLuint normalBuffer;
+    GLuint indexBuffer;
+    GLsizei indexCount;
+};
+
+// Creates programs and meshes, keyed by a hash of their shader source and
+// vertex data, so that identical ones are only ever created once.
+//
+// Where the driver supports ARB_get_program_binary, linked programs are
+// also saved to disk, keyed by source hash and driver, so later launches
+// can skip compiling and linking altogether.
+class ResourceManager {
+    public:
+        struct Stats {
+            int programRequests;
+            int programsCreated;
+            int programsFromBinary;
+            // Time spent loading or compiling programs.
+            qint64 programNanos;
+            int meshRequests;
+            int meshesCreated;
+            size_t bufferBytes;
+        };
+
+        // Uniform block binding point for every program's Camera block.
+        static const GLuint cameraBinding = 0;
+        // And for the Shadows block of the programs that receive shadows.
+        static const GLuint shadowBinding = 1;
+
+        ResourceManager();
+
+        void initialize(QOpenGLFunctions_3_3_Core *gl);
+
+        // feedback names vertex shader outputs to capture with transform
+        // feedback, interleaved in that order, for programs that have any.
+        GLuint program(const char *vertf, const char *fragf,
+                       const char *const *feedback = NULL, int feedbackCount = 0);
+        Mesh mesh(const vec3 *positions, const vec3 *normals, int vertexCount,
+                  const GLuint *indices, int indexCount);
+
+        const Stats &stats() const { return counts; }
+
+    private:
+        static uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL);
+        static std::string readFile(const char *path);
+
+        GLuint compileShader(GLenum type, const std::string &source);
+        GLuint linkProgram(const std::string &vertSource, const std::string &fragSource,
+                           const char *const *feedback, int feedbackCount);
+        void bindUniformBlocks(GLuint program);
+
+        QString binaryPath(uint64_t key) const;
+        GLuint loadBinary(uint64_t key);
+        void saveBinary(GLuint program, uint64_t key);
+
+        QOpenGLFunctions_3_3_Core *gl;
+        QOpenGLExtraFunctions *extra;
+        bool binarySupported;
+        // Hash of the vendor, renderer and version strings. A binary is
+        // only any good to the exact driver that produced it.
+        uint64_t driverHash;
+        QString cacheDir;
+        std::map<uint64_t, GLuint> programs;
+        std::map<uint64_t, Mesh> meshes;
+        Stats counts;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "scene.h"
+
+#include <cstring>
+#include <iostream>
+#include <QList>
+#include <QSaveFile>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using glm::vec3;
+
+static const char sceneMagic[4] = { 'S', 'H', 'P', 'S' };
+static const uint32_t sceneVersion = 1;
+
+Scene::Scene() {
+    mapped = NULL;
+    clear();
+}
+
+void Scene::clear() {
+    if(mapped) {
+        mappedFile.unmap(mapped);
+        mapped = NULL;
+    }
+    if(mappedFile.isOpen()) {
+        mappedFile.close();
+    }
+
+    for(int i = 0; i < sceneArrayCount; i++) {
+        owned[i].clear();
+    }
+    ownedSheep.clear();
+    useOwned();
+}
+
+void Scene::useOwned() {
+    for(int i = 0; i < sceneArrayCount; i++) {
+        arrays[i] = owned[i].empty() ? NULL : &owned[i][0];
+        counts[i] = (int)owned[i].size();
+    }
+    sheepArray = ownedSheep.empty() ? NULL : &ownedSheep[0];
+    sheepTotal = (int)ownedSheep.size();
+}
+
+bool Scene::load(const QString &path) {
+    clear();
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not open scene " << path.toStdString() << std::endl;
+        return false;
+    }
+    QByteArray start = file.peek(sizeof(sceneMagic));
+    if(start.size() == sizeof(sceneMagic) && memcmp(start.constData(), sceneMagic, sizeof(sceneMagic)) == 0) {
+        file.close();
+        return loadBinary(path);
+    }
+    return loadText(file.readAll(), path);
+}
+
+bool Scene::loadText(const QByteArray &text, const QString &path) {
+    QList<QByteArray> lines = text.split('\n');
+
+    for(int n = 0; n < lines.size(); n++) {
+        QList<QByteArray> words = lines[n].simplified().split(' ');
+        if(words[0].isEmpty() || words[0].startsWith('#')) {
+            continue;
+        }
+
+        // QByteArray::toFloat always reads a '.' decimal point, whatever
+        // the locale, unlike sscanf.
+        float v[6];
+        int read = 0;
+        bool ok = words.size() <= 7;
+        for(int i = 1; ok && i < words.size(); i++) {
+            v[read++] = words[i].toFloat(&ok);
+        }
+
+        const QByteArray &kind = words[0];
+        if(!ok) {
+            // fall through to the error below
+        } else if(kind == "ground" && read == 6) {
+            owned[groundArray].push_back(glm::translate(mat4(1.0), vec3(v[0], v[1], v[2])) *
+                                         glm::scale(mat4(1.0), vec3(v[3], v[4], v[5])));
+        } else if(kind == "tree" && read == 3) {
+            owned[treeArray].push_back(glm::translate(mat4(1.0), vec3(v[0], v[1], v[2])));
+        } else if(kind == "water" && read == 3) {
+            owned[waterArray].push_back(glm::translate(mat4(1.0), vec3(v[0], v[1], v[2])));
+        } else if(kind == "moon" && read == 3) {
+            owned[moonArray].push_back(glm::translate(mat4(1.0), vec3(v[0], v[1], v[2])));
+        } else if(kind == "sheep" && read == 6) {
+            SheepPlacement sheep;
+            sheep.x = v[0];
+            sheep.z = v[1];
+            sheep.heads = v[2];
+            sheep.turn = v[3];
+            sheep.nod = v[4];
+            sheep.fat = v[5];
+            ownedSheep.push_back(sheep);
+        } else {
+            ok = false;
+        }
+
+        if(!ok) {
+            std::cerr << path.toStdString() << ":" << n + 1
+                      << ": can't read \"" << lines[n].constData() << "\"" << std::endl;
+            clear();
+            return false;
+        }
+    }
+
+    useOwned();
+    return true;
+}
+
+bool Scene::loadBinary(const QString &path) {
+    mappedFile.setFileName(path);
+    if(!mappedFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = mappedFile.size();
+    if(size < (qint64)sizeof(BinaryHeader)) {
+        std::cerr << path.toStdString() << " is too short for a scene" << std::endl;
+        clear();
+        return false;
+    }
+    mapped = mappedFile.map(0, size);
+    if(!mapped) {
+        std::cerr << "Could not map " << path.toStdString() << std::endl;
+        clear();
+        return false;
+    }
+
+    const BinaryHeader *header = (const BinaryHeader *)mapped;
+    qint64 expected = sizeof(BinaryHeader) + (qint64)header->sheepCount * sizeof(SheepPlacement);
+    for(int i = 0; i < sceneArrayCount; i++) {
+        expected += (qint64)header->counts[i] * sizeof(mat4);
+    }
+    if(header->version != sceneVersion || expected != size) {
+        std::cerr << path.toStdString() << " is not a version " << sceneVersion
+                  << " scene or is truncated" << std::endl;
+        clear();
+        return false;
+    }
+
+    // The header is 32 bytes and a mat4 64, so every array lands on a
+    // 16 byte boundary of the page aligned mapping.
+    const uchar *p = mapped + sizeof(BinaryHeader);
+    for(int i = 0; i < sceneArrayCount; i++) {
+        counts[i] = (int)header->counts[i];
+        arrays[i] = counts[i] ? (const mat4 *)p : NULL;
+        p += counts[i] * sizeof(mat4);
+    }
+    sheepTotal = (int)header->sheepCount;
+    sheepArray = sheepTotal ? (const SheepPlacement *)p : NULL;
+    return true;
+}
+
+bool Scene::saveBinary(const QString &path) const {
+    static_assert(sizeof(BinaryHeader) == 32, "scene arrays must stay 16 byte aligned");
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sceneMagic, sizeof(sceneMagic));
+    header.version = sceneVersion;
+    for(int i = 0; i < sceneArrayCount; i++) {
+        header.counts[i] = counts[i];
+    }
+    header.sheepCount = sheepTotal;
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Could not write " << path.toStdString() << std::endl;
+        return false;
+    }
+    file.write((const char *)&header, sizeof(header));
+    for(int i = 0; i < sceneArrayCount; i++) {
+        file.write((const char *)arrays[i], counts[i] * sizeof(mat4));
+    }
+    file.write((const char *)sheepArray, sheepTotal * sizeof(SheepPlacement));
+    return file.commit();
+}
+
+void Scene::generateFlock(int side) {
+    clear();
+
+    ownedSheep.reserve(side * side);
+    for(int i = 0; i < side; i++) {
+        for(int j = 0; j < side; j++) {
+            unsigned int hash = (i * 73856093u) ^ (j * 19349663u);
+            SheepPlacement sheep;
+            sheep.x = (float)((i - side/2) * 3);
+            sheep.z = (float)((j - side/2) * 5);
+            sheep.heads = (float)(1 + hash % 4);
+            sheep.turn = (float)(hash % 17) - 8;
+            sheep.nod = (float)((hash >> 8) % 21) - 10;
+            sheep.fat = .95f + (hash >> 16) % 35 / 100.0f;
+            ownedSheep.push_back(sheep);
+        }
+    }
+    useOwned();
+}
@@ -0,0 +1,87 @@
+#ifndef __SCENE__INCLUDE__
+#define __SCENE__INCLUDE__
+
+#include <QFile>
+#include <QString>
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+using glm::mat4;
+
+// Where one sheep goes and what it looks like; the arguments to
+// Renderer::addSheep.
+struct SheepPlacement {
+    float x;
+    float z;
+    float heads;
+    float turn;
+    float nod;
+    float fat;
+};
+
+enum SceneArray {
+    groundArray,
+    treeArray,
+    waterArray,
+    moonArray,
+    sceneArrayCount
+};
+
+// Everything placed in the world, as one flat array of transforms per
+// kind of object plus an array of sheep.
+//
+// There are two formats. The text one (see sheep.scene) is for editing
+// by hand. The binary one is a small header followed by the arrays
+// exactly as they are laid out in memory, so it is memory mapped and
+// used in place: loading a big world costs one map and no per-object
+// work at all. It is written in the machine's byte order.
+class Scene {
+    public:
+        Scene();
+
+        // Picks the format from the file's first bytes.
+        bool load(const QString &path);
+        bool saveBinary(const QString &path) const;
+
+        // side x side sheep in rows with some variety, and nothing else.
+        void generateFlock(int side);
+
+        int count(SceneArray array) const { return counts[array]; }
+        const mat4 *transforms(SceneArray array) const { return arrays[array]; }
+        int sheepCount() const { return sheepTotal; }
+        const SheepPlacement *sheep() const { return sheepArray; }
+
+    private:
+        struct BinaryHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t counts[sceneArrayCount];
+            uint32_t sheepCount;
+            uint32_t pad;
+        };
+
+        void clear();
+        bool loadText(const QByteArray &text, const QString &path);
+        bool loadBinary(const QString &path);
+        // Points the arrays at the owned vectors.
+        void useOwned();
+
+        const mat4 *arrays[sceneArrayCount];
+        int counts[sceneArrayCount];
+        const SheepPlacement *sheepArray;
+        int sheepTotal;
+
+        // Backing for a text scene.
+        std::vector<mat4> owned[sceneArrayCount];
+        std::vector<SheepPlacement> ownedSheep;
+
+        // Backing for a binary one.
+        QFile mappedFile;
+        uchar *mapped;
+
+        Scene(const Scene &);
+        Scene &operator=(const Scene &);
+};
+
+#endif
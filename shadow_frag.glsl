@@ -0,0 +1,5 @@
+#version 330
+
+// Depth only, for drawing into the shadow maps.
+void main(){
+}
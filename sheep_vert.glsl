@@ -0,0 +1,153 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+uniform mat4 shape;
+uniform vec3 topColor;
+uniform vec3 sideColor;
+uniform vec3 bottomColor;
+// Work normals out the old way, with a 4x4 inverse per vertex. Only the
+// benchmark sets this, to measure what that costs.
+uniform bool inverseNormals;
+
+in vec3 position;
+in vec3 normal;
+// Which part of the sheep this vertex is: 0 the body, 1-4 the heads, 5-8
+// the backs of the heads, 9-12 the legs and 13-16 the feet.
+in float part;
+// Per sheep: head turn and nod in 45ths of a radian, fatness, heads.
+in vec4 look;
+// Per sheep: walk cycle phase, pace (0 standing, 1 walking), how far its
+// head is down grazing, and 1 / scale^2 of model if the CPU found it only
+// rotates and scales evenly (0 if not).
+in vec4 gait;
+in mat4 model;
+out vec3 fcolor;
+out vec3 uPos;
+out vec3 uNorm;
+
+mat4 translate(vec3 t) {
+  return mat4(1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  t.x, t.y, t.z, 1);
+}
+
+mat4 scale(vec3 s) {
+  return mat4(s.x, 0, 0, 0,  0, s.y, 0, 0,  0, 0, s.z, 0,  0, 0, 0, 1);
+}
+
+mat4 rotateX(float a) {
+  float c = cos(a), s = sin(a);
+  return mat4(1, 0, 0, 0,  0, c, s, 0,  0, -s, c, 0,  0, 0, 0, 1);
+}
+
+mat4 rotateY(float a) {
+  float c = cos(a), s = sin(a);
+  return mat4(c, 0, -s, 0,  0, 1, 0, 0,  s, 0, c, 0,  0, 0, 0, 1);
+}
+
+mat4 rotateZ(float a) {
+  float c = cos(a), s = sin(a);
+  return mat4(c, s, 0, 0,  -s, c, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1);
+}
+
+// Turns about an axis through pivot rather than through the origin.
+mat4 about(vec3 pivot, mat4 rotation) {
+  return translate(pivot) * rotation * translate(-pivot);
+}
+
+// Where a part sits relative to its sheep, the same layout the parts
+// always had, posed for the walk cycle and grazing. Every part is a
+// rotation and translation after a scale, kept apart so the normals can
+// be turned without inverting anything.
+void posePart(int id, out mat4 rigid, out vec3 size) {
+  float phase = gait.x;
+  float pace = gait.y;
+  float fat = look.z;
+
+  if(id == 0) {
+    // The body sways from side to side in time with the legs.
+    rigid = translate(vec3(0, -2, 0)) * rotateZ(sin(phase) * .05 * pace);
+    size = vec3(fat * 2, fat * 2, fat * 3);
+    return;
+  }
+
+  if(id < 9) {
+    bool back = id >= 5;
+    int k = back ? id - 5 : id - 1;
+    size = vec3(back ? 1.25 : 1);
+    if(float(k) >= look.w) {
+      // Not one of this sheep's heads; squashed flat, it draws nothing.
+      rigid = mat4(1);
+      size = vec3(0);
+      return;
+    }
+
+    // Heads go down to graze and bob as the sheep walks, pivoting at
+    // the neck.
+    float dip = gait.z * 1.1 + sin(phase * 2) * .1 * pace;
+    mat4 neck = about(vec3(0, -1.3, -1.2), rotateX(-dip));
+    mat4 place = translate(vec3(0, -1, back ? -1.5 : -1.8));
+
+    if(look.w < 1.5) {
+      // A one-headed sheep turns its head where it is.
+      rigid = neck * place * rotateY(look.x / 45) * rotateX(look.y / 45);
+      return;
+    }
+    // Many-headed sheep have their heads spread around them, the first
+    // turned and nodded as asked and the rest off to the sides and back.
+    float turn = look.x / 45;
+    float nod = look.y / 45;
+    if(k == 1) {
+      turn = nod = 70.0 / 45;
+    } else if(k == 2) {
+      turn = nod = -70.0 / 45;
+    } else if(k == 3) {
+      turn = nod = 140.0 / 45;
+    }
+    if(back && k > 0) {
+      nod = 0;
+    }
+    rigid = rotateY(turn) * neck * place * rotateX(nod);
+    return;
+  }
+
+  // Legs and feet, one at each corner of the body, swinging from the
+  // hip with diagonal pairs in step.
+  int leg = (id - 9) % 4;
+  vec2 corner = vec2(leg % 2 == 0 ? -.5 : .5, leg < 2 ? -1 : 1);
+  float swing = sin(phase + (leg == 0 || leg == 3 ? 0 : 3.14159265)) * .5 * pace;
+  mat4 hip = about(vec3(corner.x, -2.9, corner.y), rotateX(swing));
+  if(id < 13) {
+    rigid = hip * translate(vec3(corner.x, .65 - 4, corner.y));
+    size = vec3(.85);
+  } else {
+    rigid = hip * translate(vec3(corner.x, -4, corner.y));
+    size = vec3(.7, 1, .7);
+  }
+}
+
+void main() {
+  mat4 rigid;
+  vec3 size;
+  posePart(int(part + .5), rigid, size);
+  mat4 partModel = model * rigid * scale(size);
+  vec4 world = partModel * shape * vec4(position, 1);
+  gl_Position = projection * view * world;
+  uPos = world.xyz;
+  if(inverseNormals || gait.w == 0) {
+    uNorm = (transpose(inverse(partModel)) * vec4(normal, 0)).xyz;
+  } else {
+    // The inverse transpose of an even scale is its reciprocal, of a
+    // rotation is itself and of an axis scale is its reciprocal.
+    uNorm = mat3(model) * (gait.w * (mat3(rigid) * (normal / max(size, vec3(1e-6)))));
+  }
+  if(normal.y > .5)
+    fcolor = topColor;
+  else if(normal.y < -.5)
+    fcolor = bottomColor;
+  else
+    fcolor = sideColor;
+}
@@ -0,0 +1,28 @@
+#include "simclock.h"
+
+SimClock::SimClock(double step) {
+    stepSeconds = step;
+    accumulator = 0;
+    lastNs = 0;
+}
+
+void SimClock::start() {
+    timer.start();
+    lastNs = 0;
+    accumulator = 0;
+}
+
+int SimClock::advance() {
+    int64_t now = timer.nsecsElapsed();
+    accumulator += (now - lastNs) / 1000000000.0;
+    lastNs = now;
+
+    int steps = (int)(accumulator / stepSeconds);
+    if(steps > maxSteps) {
+        steps = maxSteps;
+        accumulator = 0;
+    } else {
+        accumulator -= steps * stepSeconds;
+    }
+    return steps;
+}
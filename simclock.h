@@ -0,0 +1,37 @@
+#ifndef __SIMCLOCK__INCLUDE__
+#define __SIMCLOCK__INCLUDE__
+
+#include <QElapsedTimer>
+#include <stdint.h>
+
+// Fixed timestep clock. Real time since the last call to advance goes
+// into an accumulator, which is paid out in whole steps of exactly
+// stepSeconds; whatever is left over is how far render state should be
+// interpolated between the last two steps. The simulation then runs the
+// same no matter how often (or how evenly) frames get drawn.
+class SimClock {
+    public:
+        SimClock(double stepSeconds = 1.0 / 120.0);
+
+        void start();
+
+        // Number of fixed steps to run this frame.
+        int advance();
+
+        double step() const { return stepSeconds; }
+        // How far between the previous and the latest step to draw, 0..1.
+        float alpha() const { return (float)(accumulator / stepSeconds); }
+
+    private:
+        // A hitch (dragging the window, a breakpoint) longer than this is
+        // not caught up on, or the steps to catch up would make the next
+        // frame slow as well and so on.
+        static const int maxSteps = 15;
+
+        QElapsedTimer timer;
+        int64_t lastNs;
+        double stepSeconds;
+        double accumulator;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+
+const float Terrain::leafSize = 8.0f;
+
+// A level's range is this many of its patches across. Far enough out
+// that any patch is at least a quarter of its range into morphing by the
+// time its neighbour is a level coarser, which is what keeps the seams
+// closed.
+static const float rangeScale = 8.0f;
+// Morphing starts this far into a level's range.
+static const float morphStart = .75f;
+
+Terrain::Terrain() {
+    field = 0;
+    selectFrustum = 0;
+    selectFar = 0;
+    float size = leafSize;
+    for(int level = 0; level < levels; level++) {
+        ranges[level] = size * rangeScale;
+        size *= 2;
+    }
+}
+
+void Terrain::initialize(ResourceManager &resources) {
+    initializeOpenGLFunctions();
+
+    // Vertices are at whole grid steps, 0 to gridSize, so the shader can
+    // tell odd ones from even exactly.
+    std::vector<vec3> positions;
+    std::vector<vec3> normals;
+    std::vector<GLuint> indices;
+    for(int z = 0; z <= gridSize; z++) {
+        for(int x = 0; x <= gridSize; x++) {
+            positions.push_back(vec3(x, 0, z));
+            normals.push_back(vec3(0, 1, 0));
+        }
+    }
+    for(int z = 0; z < gridSize; z++) {
+        for(int x = 0; x < gridSize; x++) {
+            GLuint a = z * (gridSize + 1) + x;
+            GLuint b = a + 1;
+            GLuint c = a + gridSize + 1;
+            GLuint d = c + 1;
+            indices.push_back(a);
+            indices.push_back(c);
+            indices.push_back(b);
+            indices.push_back(b);
+            indices.push_back(c);
+            indices.push_back(d);
+        }
+    }
+    grid = resources.mesh(&positions[0], &normals[0], (int)positions.size(),
+                          &indices[0], (int)indices.size());
+    prog = resources.program(":/terrain_vert.glsl", ":/cube_frag.glsl");
+
+    glGenBuffers(1, &patchBuffer);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, grid.positionBuffer);
+    glEnableVertexAttribArray(positionAttrib);
+    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid.indexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, patchBuffer);
+    glEnableVertexAttribArray(nodeAttrib);
+    glVertexAttribPointer(nodeAttrib, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribDivisor(nodeAttrib, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    // Read with texelFetch and blended in the shader, the same way the
+    // CPU does, so none of these matter much.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    vec4 morph[levels];
+    for(int level = 0; level < levels; level++) {
+        morph[level] = vec4(ranges[level] * morphStart, ranges[level], 0, 0);
+    }
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "heightmap"), 0);
+    glUniform1f(glGetUniformLocation(prog, "gridSize"), (float)gridSize);
+    glUniform4fv(glGetUniformLocation(prog, "morphRanges"), levels, &morph[0].x);
+    glUseProgram(0);
+}
+
+void Terrain::setHeightfield(const Heightfield &heights) {
+    field = &heights;
+    int side = heights.size();
+    if(side == 0) {
+        return;
+    }
+
+    // Height and its slope along x and z, from the samples either side.
+    const float *h = heights.samples();
+    int mask = side - 1;
+    float inv = 1 / (2 * heights.spacing());
+    std::vector<vec4> texels((size_t)side * side);
+    for(int j = 0; j < side; j++) {
+        for(int i = 0; i < side; i++) {
+            float dx = h[j * side + ((i + 1) & mask)] - h[j * side + ((i - 1) & mask)];
+            float dz = h[((j + 1) & mask) * side + i] - h[((j - 1) & mask) * side + i];
+            texels[(size_t)j * side + i] = vec4(h[j * side + i], dx * inv, dz * inv, 0);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, side, side, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUseProgram(prog);
+    glUniform1f(glGetUniformLocation(prog, "spacing"), heights.spacing());
+    glUseProgram(0);
+}
+
+int Terrain::select(const Frustum &frustum, vec3 eye, float farDistance) {
+    patches.clear();
+    if(!field) {
+        return 0;
+    }
+    selectFrustum = &frustum;
+    selectEye = eye;
+    selectFar = farDistance;
+
+    // Whole roots around the camera, as far as it can see.
+    float rootSize = leafSize * (1 << (levels - 1));
+    int x0 = (int)floorf((eye.x - farDistance) / rootSize);
+    int x1 = (int)floorf((eye.x + farDistance) / rootSize);
+    int z0 = (int)floorf((eye.z - farDistance) / rootSize);
+    int z1 = (int)floorf((eye.z + farDistance) / rootSize);
+    for(int x = x0; x <= x1; x++) {
+        for(int z = z0; z <= z1; z++) {
+            selectNode(x * rootSize, z * rootSize, levels - 1);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, patchBuffer);
+    glBufferData(GL_ARRAY_BUFFER, patches.size() * sizeof(vec4), patches.empty() ? NULL : &patches[0],
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return (int)patches.size();
+}
+
+void Terrain::selectNode(float x, float z, int level) {
+    float size = leafSize * (1 << level);
+    Aabb box(vec3(x, field->minHeight(), z), vec3(x + size, field->maxHeight(), z + size));
+    if(selectFrustum->classify(box) == Frustum::outside) {
+        return;
+    }
+
+    // Nearest the box gets to the camera.
+    vec3 nearest = glm::clamp(selectEye, box.min, box.max);
+    float distance = glm::length(nearest - selectEye);
+    if(distance > selectFar) {
+        return;
+    }
+
+    if(level == 0 || distance > ranges[level - 1]) {
+        patches.push_back(vec4(x, z, size, level));
+        return;
+    }
+    float half = size / 2;
+    selectNode(x, z, level - 1);
+    selectNode(x + half, z, level - 1);
+    selectNode(x, z + half, level - 1);
+    selectNode(x + half, z + half, level - 1);
+}
@@ -0,0 +1,72 @@
+#ifndef __TERRAIN__INCLUDE__
+#define __TERRAIN__INCLUDE__
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.h"
+#include "heightfield.h"
+#include "resourcemanager.h"
+
+using glm::vec3;
+using glm::vec4;
+
+// Draws a Heightfield with continuous distance-dependent level of detail
+// (CDLOD).
+//
+// There's one grid mesh, gridSize quads a side, and every patch of
+// terrain is an instance of it: a corner, a size and a level. The
+// terrain is a quadtree whose leaves are leafSize across; a node is
+// split while the camera is within its children's range, each level's
+// range being twice the last, so there are about as many patches at
+// every level and the vertex count hardly grows with view distance.
+// terrain_vert.glsl displaces the grid by the heightfield and, over the
+// last quarter of a patch's range, slides its odd vertices onto its even
+// ones, so by the edge of the range it's the same as the next level's
+// grid and the two meet without cracks.
+class Terrain : protected QOpenGLFunctions_3_3_Core {
+    public:
+        static const int gridSize = 16;
+        static const float leafSize;
+        static const int levels = 6;
+
+        Terrain();
+
+        // Needs the GL context to be current.
+        void initialize(ResourceManager &resources);
+        // Uploads the heights, and their slopes for lighting. Keeps a
+        // pointer to heights for its bounds.
+        void setHeightfield(const Heightfield &heights);
+
+        // Picks the patches for a camera at eye, out to farDistance, and
+        // uploads them. Returns how many, 0 before setHeightfield.
+        int select(const Frustum &frustum, vec3 eye, float farDistance);
+
+        GLuint program() const { return prog; }
+        GLuint vertexArray() const { return vao; }
+        GLuint texture() const { return heightTexture; }
+        GLsizei indexCount() const { return grid.indexCount; }
+        GLsizei patchCount() const { return (GLsizei)patches.size(); }
+
+    private:
+        void selectNode(float x, float z, int level);
+
+        const Heightfield *field;
+        GLuint prog;
+        Mesh grid;
+        GLuint vao;
+        GLuint patchBuffer;
+        GLuint heightTexture;
+        // Past this the level is done morphing into the next one.
+        float ranges[levels];
+
+        // Only for the duration of select.
+        const Frustum *selectFrustum;
+        vec3 selectEye;
+        float selectFar;
+        // Corner x and z, size and level.
+        std::vector<vec4> patches;
+};
+
+#endif
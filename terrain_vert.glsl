@@ -0,0 +1,61 @@
+#version 330
+
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
+uniform vec3 topColor;
+uniform vec3 sideColor;
+// Height, and its slope along x and z, per sample; repeats.
+uniform sampler2D heightmap;
+// World units between samples.
+uniform float spacing;
+// Quads along a side of the grid.
+uniform float gridSize;
+// Per level: where morphing into the next level starts, and where it's
+// done.
+uniform vec4 morphRanges[8];
+
+// Grid vertex, 0 to gridSize in x and z.
+in vec3 position;
+// Per patch: corner x and z, size and level; see terrain.h.
+in vec4 node;
+out vec3 fcolor;
+out vec3 uPos;
+out vec3 uNorm;
+
+// The same blend of the four samples around xz as Heightfield::height.
+vec4 sampleHeight(vec2 xz) {
+  vec2 f = xz / spacing;
+  vec2 i = floor(f);
+  vec2 t = f - i;
+  ivec2 mask = textureSize(heightmap, 0) - 1;
+  ivec2 p = ivec2(i) & mask;
+  ivec2 q = (p + 1) & mask;
+  vec4 a = mix(texelFetch(heightmap, p, 0), texelFetch(heightmap, ivec2(q.x, p.y), 0), t.x);
+  vec4 b = mix(texelFetch(heightmap, ivec2(p.x, q.y), 0), texelFetch(heightmap, q, 0), t.x);
+  return mix(a, b, t.y);
+}
+
+void main() {
+  float size = node.z;
+  vec2 xz = node.xy + position.xz / gridSize * size;
+
+  // Odd vertices slide back onto their even neighbours as the patch
+  // nears the end of its range, which leaves the next level's grid.
+  float distance = length(cameraPosition.xyz - vec3(xz.x, sampleHeight(xz).x, xz.y));
+  vec4 range = morphRanges[int(node.w)];
+  float morph = clamp((distance - range.x) / (range.y - range.x), 0, 1);
+  vec2 odd = fract(position.xz * .5) * 2;
+  xz -= odd / gridSize * size * morph;
+
+  vec4 h = sampleHeight(xz);
+  vec4 world = vec4(xz.x, h.x, xz.y, 1);
+  gl_Position = projection * view * world;
+  uPos = world.xyz;
+  uNorm = normalize(vec3(-h.y, 1, -h.z));
+  // Bare on the steep bits.
+  fcolor = mix(sideColor, topColor, smoothstep(.75, .95, uNorm.y));
+}
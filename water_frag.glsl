@@ -1,22 +1,37 @@
 #version 330
 
-uniform mat4 view;
+layout(std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec4 cameraPosition;
+  vec4 lightPosition;
+};
 in vec3 fcolor;
 out vec4 color_out;
-uniform vec3 lightPos;
 in vec3 uPos;
-in vec3 camPos;
 in vec3 uNorm;
-float ambient = .1;
-float shininess = 1;
-float speck = 1;
+uniform float ambient;
+uniform float shininess;
+uniform float speck;
+// The scene from the mirrored camera, and what takes a pixel on screen to
+// the same spot in it.
+uniform sampler2D reflection;
+uniform vec2 reflectionScale;
 
 
 void main(){
         vec3 N = normalize(uNorm);
-        vec3 L = normalize(lightPos - uPos);
+        vec3 L = normalize(lightPosition.xyz - uPos);
         vec3 R = 2*dot(N,L)*N - L;
-        vec3 V = normalize(camPos- uPos);
-        color_out = vec4((fcolor * (dot(uNorm, L) + ambient) + (vec3(1,1,1) * speck *pow(clamp(dot(R,V),0,1),shininess)), 1) ;
+        vec3 V = normalize(cameraPosition.xyz - uPos);
+        vec3 color = fcolor * (dot(uNorm, L) + ambient) + (vec3(1,1,1) * speck *pow(clamp(dot(R,V),0,1),shininess));
 
+        // Only the top of the lake is a mirror, and more of one the
+        // flatter it's looked at.
+        if(N.y > .5) {
+                vec3 mirrored = texture(reflection, gl_FragCoord.xy * reflectionScale).rgb;
+                float fresnel = .25 + .6 * pow(1 - clamp(dot(N, V), 0, 1), 3);
+                color = mix(color, mirrored, fresnel);
+        }
+        color_out = vec4(color, 1);
 }